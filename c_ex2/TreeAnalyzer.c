@@ -19,17 +19,29 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include "queue.h"
+#include <limits.h>
+
+#ifdef PARSE_STATS
+#include <time.h>
+#endif
 
 #define MAX_CLI_ARG 4
-#define MAX_LINE 1024
+#define BLOCK_SIZE (1 << 20)
+#define BYTES_IN_MB (1024.0 * 1024.0)
+#define TREE_INT_ARRAYS 8
 #define FILE_IDX 1
 #define FIRST_NODE 2
 #define SECOND_NODE 3
 #define READ "r"
 #define KEY_FACTOR 2
 #define NUMBER_BASE 10
-#define USAGE_ERR "Usage: TreeAnalyzer <Graph File Path> <First Vertex> <Second Vertex>\n"
+#define PAIRS_FILE_IDX 3
+#define PAIRS_FLAG "--pairs"
+#define PAIR_SIZE 2
+#define MIN_PAIRS_CAPACITY 64
+#define LCA_INT_ARRAYS 3
+#define USAGE_ERR "Usage: TreeAnalyzer <Graph File Path> <First Vertex> <Second Vertex>\n" \
+                  "       TreeAnalyzer <Graph File Path> --pairs <Pairs File Path>\n"
 #define INPUT_ERR "Invalid input\n"
 #define ROOT_MSG "Root Vertex:"
 #define NODE_COUNT "Vertices Count:"
@@ -40,77 +52,108 @@
 #define SHORTEST_PATH_MSG "Shortest Path Between %d and %d: "
 #define UNDEFINED_SIZE -1
 #define MIN_TREE_SIZE 1
-#define IS_LEAF -2
-#define LEAF 1
 #define FIRST_LINE 1
 #define SEPARATOR " \t"
 #define EQUAL 0
-#define VISITED 1
-#define EMPTY_QUEUE 1
 #define SPACE_ASCII 32
 #define NEW_LINE '\n'
 #define LINE_WIN '\r'
-#define NEW_LINE_WIN "\r\n"
-#define LEAF_INDICATOR "-"
+#define LEAF_INDICATOR '-'
 #define INT_LOW 48
 #define INT_HI 57
-#define LEAF_WIN "-\r\n"
-#define LEAF_LIN "-\n"
 
 /**
- * The struct define one Vertex in the Graph
+ * the bfs queue, a ring buffer over a preallocated array. a tree bfs visits every vertex once, so the capacity
+ * is the tree size and it never fills up.
+ */
+typedef struct Frontier
+{
+    int *items;
+    int head;
+    int count;
+    int capacity;
+} Frontier;
+
+/**
+ * The struct define the Graph. the sons of vertex v are sons[sonsStart[v]..sonsStart[v + 1]) (compressed sparse
+ * rows), and every other field of a vertex has its own array, so bfs reads each of them sequentially. all the
+ * arrays share one allocation.
  */
-typedef struct Vertex
+typedef struct Tree
 {
-    int parent;
+    int size;
+    int sonsCount;
+    int *sonsStart;
     int *sons;
-    int isLeaf;
-    int childrenCount;
-    int dist;
-    int prev;
-    int visit;
-} Vertex;
+    int *parent;
+    int *dist;
+    int *prev;
+    int *height;
+    int *order;
+    bool *isLeaf;
+    Frontier frontier;
+} Tree;
 
 /**
- * the function initiate a tree with default values
+ * the measures printOutput reports about the tree
+ */
+typedef struct TreeMetrics
+{
+    int root;
+    int reached;
+    int minBranch;
+    int maxBranch;
+    int diameter;
+} TreeMetrics;
+
+/**
+ * the function allocates a tree with default values
  * @param tree our tree
  * @param size the size of the tree
+ * @return 0 on success, 1 on failure
  */
-void initTree(Vertex **tree, int size)
+int initTree(Tree *tree, int size)
 {
+    int *block = (int *) malloc(TREE_INT_ARRAYS * (size_t) size * sizeof(int) + sizeof(int) +
+                                (size_t) size * sizeof(bool));
+    if (block == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    tree->size = size;
+    tree->sonsCount = 0;
+    tree->sonsStart = block;
+    tree->sons = tree->sonsStart + size + 1;
+    tree->parent = tree->sons + size;
+    tree->dist = tree->parent + size;
+    tree->prev = tree->dist + size;
+    tree->height = tree->prev + size;
+    tree->order = tree->height + size;
+    tree->frontier.items = tree->order + size;
+    tree->frontier.head = 0;
+    tree->frontier.count = 0;
+    tree->frontier.capacity = size;
+    tree->isLeaf = (bool *) (tree->frontier.items + size);
+    tree->sonsStart[0] = 0;
     for (int i = 0; i < size; ++i)
     {
-        (*tree)[i].childrenCount = 0;
-        (*tree)[i].sons = NULL;
-        (*tree)[i].parent = -1;
-        (*tree)[i].prev = -1;
-        (*tree)[i].dist = -1;
-        (*tree)[i].visit = -1;
-        (*tree)[i].isLeaf = -1;
+        tree->parent[i] = UNDEFINED_SIZE;
+        tree->prev[i] = UNDEFINED_SIZE;
+        tree->dist[i] = UNDEFINED_SIZE;
+        tree->isLeaf[i] = false;
     }
+    return EXIT_SUCCESS;
 }
 
 /**
  * the function free all the allocated memory
  * @param tree the tree we build
- * @param treeSize the tree Size
  */
-void freeEverything(Vertex **tree, int treeSize)
+void freeEverything(Tree *tree)
 {
-    int i = 0;
-    if (*tree != NULL)
-    {
-        while (i < treeSize)
-        {
-            if ((*tree)[i].sons != NULL)
-            {
-                free((*tree)[i].sons);
-            }
-            ++i;
-        }
-        free(*tree);
-        *tree = NULL;
-    }
+    free(tree->sonsStart);
+    tree->sonsStart = NULL;
+    tree->size = 0;
 }
 
 /**
@@ -130,201 +173,240 @@ void errMsg(bool isUsage)
 }
 
 /**
- * closes the file and return fail
- * @param file the file we want to close
- * @return 1
+ * the state of the parser between two blocks of the file, so a line may be split anywhere
  */
-int fileErrorHandling(FILE *file)
+typedef struct LineParser
 {
-    fclose(file);
-    return EXIT_FAILURE;
+    int lineNum;
+    long number;
+    bool inNumber;
+    bool hasDash;
+    bool hasContent;
+    bool afterCr;
+} LineParser;
+
+/**
+ * appends a digit to a number. the bound is checked before the multiplication, so the number never overflows.
+ * @param number the number read so far
+ * @param c the digit
+ * @param maxNumber the largest number allowed
+ * @return 0 on success, 1 if the number would be larger than maxNumber
+ */
+int pushDigit(long *number, char c, long maxNumber)
+{
+    int digit = c - INT_LOW;
+    if (digit > maxNumber || *number > (maxNumber - digit) / NUMBER_BASE)
+    {
+        return EXIT_FAILURE;
+    }
+    *number = *number * NUMBER_BASE + digit;
+    return EXIT_SUCCESS;
 }
 
 /**
- * validate the line and parse it into integer arr
- * @param line a line from the given file
- * @return the size of vertex
+ * adds the number just parsed to the sons of the current vertex, and connects it to its parent. a vertex may
+ * be the son of only one vertex.
+ * @param parser the parser
+ * @param tree the tree
+ * @return 0 on success, 1 on failure
  */
-int checkFirstLine(char line[MAX_LINE])
+int pushSon(LineParser *parser, Tree *tree)
 {
-    int i = 0;
-    for (; i < (int) strlen(line); ++i)
+    int curVertex = parser->lineNum - KEY_FACTOR;
+    int son = (int) parser->number;
+    if (curVertex >= tree->size || tree->parent[son] != UNDEFINED_SIZE)
     {
-        if (!(line[i] >= INT_LOW && line[i] <= INT_HI) && line[i] != NEW_LINE && line[i] != LINE_WIN)
-        {
-            return UNDEFINED_SIZE;
-        }
+        return EXIT_FAILURE;
     }
-    char *candidate = strtok(line, SEPARATOR);
-    int num = (int) strtol(candidate, NULL, NUMBER_BASE);
-    if (num < MIN_TREE_SIZE)
+    tree->parent[son] = curVertex;
+    tree->sons[tree->sonsCount++] = son;
+    parser->inNumber = false;
+    parser->number = 0;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * validates the first line (only digits, the tree size, at least 1) and allocates the tree
+ * @param parser the parser, at the end of the first line
+ * @param tree the tree we want to build
+ * @return 0 on success, 1 on failure
+ */
+int endFirstLine(LineParser *parser, Tree *tree)
+{
+    if (!parser->inNumber || parser->number < MIN_TREE_SIZE)
     {
-        return UNDEFINED_SIZE;
+        return EXIT_FAILURE;
     }
-    return num;
+    return initTree(tree, (int) parser->number);
 }
 
 /**
- * validate single line in the file,
- * check if their no double node (the same node) , no char , the vertices < size
- * @param line a line from the input file
- * @return the num of children if the line is valid, otherwise return -1
+ * validates a vertex line and closes its row of sons
+ * @param parser the parser, at the end of the line
+ * @param tree the tree
+ * @return 0 on success, 1 on failure
  */
-int validateLine(char line[MAX_LINE], int curSonsArr[MAX_LINE], int treeSize) //TODO WORKS
+int endVertexLine(LineParser *parser, Tree *tree)
 {
-    int childrens = 0;
-    if ((strcmp(line, LEAF_LIN) == EQUAL) || (strcmp(line, LEAF_WIN) == EQUAL) ||
-        (strcmp(line, LEAF_INDICATOR) == EQUAL))
+    int curVertex = parser->lineNum - KEY_FACTOR;
+    if (curVertex >= tree->size || !parser->hasContent)
     {
-        return IS_LEAF;
+        return EXIT_FAILURE;
     }
-    if ((strcmp(line, "\n") == EQUAL) || (strcmp(line, NEW_LINE_WIN) == EQUAL))
+    if (parser->inNumber && pushSon(parser, tree) == EXIT_FAILURE)
     {
-        return UNDEFINED_SIZE;
+        return EXIT_FAILURE;
     }
-    for (int i = 0; i < (int) strlen(line); ++i)
+    tree->isLeaf[curVertex] = parser->hasDash;
+    tree->sonsStart[curVertex + 1] = tree->sonsCount;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * ends the current line and resets the parser for the next one
+ * @param parser the parser
+ * @param tree the tree
+ * @return 0 on success, 1 on failure
+ */
+int endLine(LineParser *parser, Tree *tree)
+{
+    int flag;
+    if (parser->lineNum == FIRST_LINE)
     {
-        bool isNum = (!(line[i] >= INT_LOW && line[i] <= INT_HI));
-        if (isNum && (line[i] != SPACE_ASCII) && line[i] != NEW_LINE && line[i] != LINE_WIN)
-        {
-            return UNDEFINED_SIZE;
-        }
+        flag = endFirstLine(parser, tree);
     }
-    char *p = strtok(line, SEPARATOR);
-    while (p != NULL)
+    else
     {
-        if ((*p == NEW_LINE) || (strcmp(line, LEAF_WIN) == EQUAL))
-        {
-            break;
-        }
-        int candidate = (int) strtol(p, NULL, NUMBER_BASE);
-        if (candidate > treeSize - 1)
-        {
-            return UNDEFINED_SIZE;
-        }
-        curSonsArr[childrens] = candidate;
-        childrens++;
-        p = strtok(NULL, SEPARATOR);
+        flag = endVertexLine(parser, tree);
     }
-    return childrens;
+    parser->lineNum++;
+    parser->number = 0;
+    parser->inNumber = false;
+    parser->hasDash = false;
+    parser->hasContent = false;
+    parser->afterCr = false;
+    return flag;
 }
 
 /**
- * parse the file data to a tree
- * @param fileName the given file name
+ * validates and parses one block of the file in a single scan. a vertex line is either "-" or vertex numbers
+ * separated by spaces, the first line is the tree size, and every line may end with "\r\n". a '\r' anywhere else
+ * than right before a '\n' or at the end of the file is rejected.
+ * @param parser the parser
+ * @param block the block
+ * @param len the block length
  * @param tree the tree we want to build
- * @param treeSize the tree size
- * @return 1 if failed, 0 otherwise
+ * @return 0 on success, 1 on failure
  */
-int parseFile(const char *fileName, Vertex **tree, int *treeSize)
+int parseBlock(LineParser *parser, const char *block, size_t len, Tree *tree)
 {
-    FILE *file;
-    char line[MAX_LINE];
-    int lineNum = FIRST_LINE;
-    file = fopen(fileName, READ);
-    if (file == NULL)
+    for (size_t i = 0; i < len; ++i)
     {
-        return fileErrorHandling(file);
-    }
-    int sizeOfChildren = 0;
-    int curVertex = 0;
-    int curSonsArr[MAX_LINE];
-    while ((fgets(line, MAX_LINE, file) != NULL))
-    {
-        if (lineNum == FIRST_LINE)
+        char c = block[i];
+        long maxNumber = parser->lineNum == FIRST_LINE ? INT_MAX : tree->size - 1;
+        if (parser->afterCr && c != NEW_LINE)
         {
-            *treeSize = checkFirstLine(line);
-            if (*treeSize == UNDEFINED_SIZE)
+            return EXIT_FAILURE;
+        }
+        if (c >= INT_LOW && c <= INT_HI)
+        {
+            if (parser->hasDash || pushDigit(&parser->number, c, maxNumber) == EXIT_FAILURE)
             {
-                return fileErrorHandling(file);
+                return EXIT_FAILURE;
             }
-            *tree = (Vertex *) malloc(((*treeSize) * sizeof(Vertex)));
-            if (*tree == NULL)
+            parser->inNumber = true;
+            parser->hasContent = true;
+        }
+        else if (c == SPACE_ASCII && parser->lineNum != FIRST_LINE && !parser->hasDash)
+        {
+            if (parser->inNumber && pushSon(parser, tree) == EXIT_FAILURE)
             {
-                return fileErrorHandling(file);
+                return EXIT_FAILURE;
             }
-            initTree(tree, *treeSize);
-            lineNum++;
-            continue;
+            parser->hasContent = true;
         }
-        curVertex = lineNum - KEY_FACTOR;
-        sizeOfChildren = validateLine(line, curSonsArr, *treeSize);
-        if (sizeOfChildren == UNDEFINED_SIZE)
+        else if (c == LEAF_INDICATOR && parser->lineNum != FIRST_LINE && !parser->hasContent)
         {
-            return fileErrorHandling(file);
+            parser->hasDash = true;
+            parser->hasContent = true;
         }
-        if (sizeOfChildren == IS_LEAF)
+        else if (c == NEW_LINE)
         {
-            (*tree)[curVertex].isLeaf = LEAF;
-            (*tree)[curVertex].childrenCount = 0;
-            ++lineNum;
-            continue;
+            if (endLine(parser, tree) == EXIT_FAILURE)
+            {
+                return EXIT_FAILURE;
+            }
         }
-        if (curVertex >= *treeSize)
+        else if (c == LINE_WIN)
         {
-            return fileErrorHandling(file);
+            parser->afterCr = true;
         }
         else
         {
-            (*tree)[curVertex].childrenCount = sizeOfChildren;
-            (*tree)[curVertex].sons = (int *) malloc((sizeOfChildren) * sizeof(int));
-            for (int i = 0; i < sizeOfChildren; ++i)
-            {
-                if ((*tree)[curSonsArr[i]].visit != VISITED)
-                {
-                    (*tree)[curVertex].sons[i] = curSonsArr[i];
-                    int i1 = curSonsArr[i];
-                    (*tree)[i1].visit = VISITED;
-                }
-                else
-                {
-                    return fileErrorHandling(file);
-                }
-            }
-            ++lineNum;
+            return EXIT_FAILURE;
         }
     }
-    if ((*treeSize != (lineNum - KEY_FACTOR)))
-    {
-        fclose(file);
-        return EXIT_FAILURE;
-    }
-    fclose(file);
     return EXIT_SUCCESS;
 }
 
 /**
- * iterate thru the tree nodes and connect between a node and its parent
- * @param tree the tree
- * @param treeSize the tree size
+ * parse the file data to a tree, reading it in large blocks. the parents are connected while parsing.
+ * @param fileName the given file name
+ * @param tree the tree we want to build
+ * @return 1 if failed, 0 otherwise
  */
-void setParent(Vertex **tree, int treeSize)
+int parseFile(const char *fileName, Tree *tree)
 {
-    for (int k = 0; k < treeSize; ++k)
+    FILE *file = fopen(fileName, READ);
+    if (file == NULL)
     {
-        if ((*tree)[k].isLeaf != LEAF)
-        {
-            for (int l = 0; l < (*tree)[k].childrenCount; ++l)
-            {
-                int sonIdx = (*tree)[k].sons[l];
-                (*tree)[sonIdx].parent = k;
-            }
-        }
+        return EXIT_FAILURE;
     }
+    LineParser parser = {FIRST_LINE, 0, false, false, false, false};
+    char *block = (char *) malloc(BLOCK_SIZE);
+    int flag = block == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+    bool endsWithLine = true;
+#ifdef PARSE_STATS
+    clock_t start = clock();
+    size_t total = 0;
+#endif
+    size_t len;
+    while (flag == EXIT_SUCCESS && (len = fread(block, 1, BLOCK_SIZE, file)) > 0)
+    {
+        flag = parseBlock(&parser, block, len, tree);
+        endsWithLine = block[len - 1] == NEW_LINE;
+#ifdef PARSE_STATS
+        total += len;
+#endif
+    }
+    if (flag == EXIT_SUCCESS && (ferror(file) || (!endsWithLine && endLine(&parser, tree))))
+    {
+        flag = EXIT_FAILURE;
+    }
+    if (flag == EXIT_SUCCESS && (tree->sonsStart == NULL || tree->size != parser.lineNum - KEY_FACTOR))
+    {
+        flag = EXIT_FAILURE;
+    }
+#ifdef PARSE_STATS
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    fprintf(stderr, "parsed %zu bytes in %.3f s (%.1f MB/s)\n", total, seconds,
+            seconds > 0 ? (double) total / BYTES_IN_MB / seconds : 0);
+#endif
+    free(block);
+    fclose(file);
+    return flag;
 }
 
 /**
  *  the function find the tree root
  * @param tree the tree
- * @param treeSize the tree size
  * @return the tree root, -1 if not found
  */
-int getRoot(Vertex *tree, int treeSize)
+int getRoot(const Tree *tree)
 {
-    int i = 0;
-    for (i = 0; i < treeSize; i++)
+    for (int i = 0; i < tree->size; i++)
     {
-        if (tree[i].parent == UNDEFINED_SIZE)
+        if (tree->parent[i] == UNDEFINED_SIZE)
         {
             return i;
         }
@@ -333,115 +415,173 @@ int getRoot(Vertex *tree, int treeSize)
 }
 
 /**
- * bfs according to the given psudo code
+ * adds a vertex at the tail of the frontier
+ * @param frontier the frontier, not full
+ * @param vertex the vertex
+ */
+void pushFrontier(Frontier *frontier, int vertex)
+{
+    int tail = frontier->head + frontier->count;
+    if (tail >= frontier->capacity)
+    {
+        tail -= frontier->capacity;
+    }
+    frontier->items[tail] = vertex;
+    ++frontier->count;
+}
+
+/**
+ * removes the vertex at the head of the frontier
+ * @param frontier the frontier, not empty
+ * @return the vertex
+ */
+int popFrontier(Frontier *frontier)
+{
+    int vertex = frontier->items[frontier->head];
+    if (++frontier->head == frontier->capacity)
+    {
+        frontier->head = 0;
+    }
+    --frontier->count;
+    return vertex;
+}
+
+/**
+ * bfs according to the given psudo code, with the tree frontier as its queue
  * @param tree the tree
- * @param treeSize  the tree size
  * @param vertex the vertex we start from
  */
-void bfs(Vertex **tree, int treeSize, int vertex)
+void bfs(Tree *tree, int vertex)
 {
-    for (int i = 0; i < treeSize; ++i)
+    for (int i = 0; i < tree->size; ++i)
     {
-        (*tree)[i].dist = UNDEFINED_SIZE;
+        tree->dist[i] = UNDEFINED_SIZE;
+        tree->prev[i] = UNDEFINED_SIZE;
     }
-    (*tree)[vertex].dist = EQUAL;
-    (*tree)[vertex].prev = UNDEFINED_SIZE;
-    Queue *queue = allocQueue();
-    enqueue(queue, (vertex));
-    while (queueIsEmpty(queue) != EMPTY_QUEUE)
+    tree->dist[vertex] = EQUAL;
+    Frontier *frontier = &tree->frontier;
+    frontier->head = 0;
+    frontier->count = 0;
+    pushFrontier(frontier, vertex);
+    while (frontier->count > 0)
     {
-        int curKey = (int) dequeue(queue);
-        int keyParent = (*tree)[curKey].parent;
+        int curKey = popFrontier(frontier);
+        int keyParent = tree->parent[curKey];
         if (keyParent != UNDEFINED_SIZE)
         {
-            if ((*tree)[keyParent].dist == UNDEFINED_SIZE)
+            if (tree->dist[keyParent] == UNDEFINED_SIZE)
             {
-                (*tree)[keyParent].prev = (int) curKey;
-                (*tree)[keyParent].dist = (*tree)[curKey].dist + 1;
-                enqueue(queue, keyParent);
+                tree->prev[keyParent] = curKey;
+                tree->dist[keyParent] = tree->dist[curKey] + 1;
+                pushFrontier(frontier, keyParent);
             }
         }
-        for (int i = 0; i < (*tree)[curKey].childrenCount; ++i)
+        for (int i = tree->sonsStart[curKey]; i < tree->sonsStart[curKey + 1]; ++i)
         {
-            int curSonIdx = (*tree)[curKey].sons[i];
-            if ((*tree)[curSonIdx].dist == UNDEFINED_SIZE)
+            int curSonIdx = tree->sons[i];
+            if (tree->dist[curSonIdx] == UNDEFINED_SIZE)
             {
-                (*tree)[curSonIdx].prev = (int) curKey;
-                (*tree)[curSonIdx].dist = (*tree)[curKey].dist + 1;
-                enqueue(queue, curSonIdx);
+                tree->prev[curSonIdx] = curKey;
+                tree->dist[curSonIdx] = tree->dist[curKey] + 1;
+                pushFrontier(frontier, curSonIdx);
             }
         }
     }
-    freeQueue(&queue);
 }
 
 /**
- * finds the minimum and maximum branches in the tree
+ * orders the vertices under the root so every vertex comes after its parent, and sets their depth in dist
  * @param tree the tree
- * @param treeSize  the tree size
  * @param root the root of the tree
- * @param minVal the shortest branch
- * @param maxVal the longest branch
- * @return the maxVal idx
+ * @return the number of vertices under the root (including it)
  */
-int findMinMaxBranch(Vertex *tree, int treeSize, int root, int *minVal, int *maxVal)
+int orderFromRoot(Tree *tree, int root)
 {
-    int curMin = treeSize + 1;
-    int curMax = 0, maxIdx = 0;
-    bfs(&tree, treeSize, root);
-    for (int i = 0; i < treeSize; ++i)
+    for (int i = 0; i < tree->size; ++i)
     {
-        if (tree[i].dist > curMax)
-        {
-            curMax = tree[i].dist;
-            maxIdx = i;
-        }
-        if ((tree[i].dist != EQUAL) && (tree[i].dist < curMin) && (tree[i].isLeaf == LEAF))
-        {
-            curMin = tree[i].dist;
-        }
+        tree->dist[i] = UNDEFINED_SIZE;
     }
-    if (treeSize == MIN_TREE_SIZE)
+    tree->dist[root] = EQUAL;
+    tree->order[0] = root;
+    int count = 1;
+    for (int head = 0; head < count; ++head)
     {
-        curMin = 0;
+        int cur = tree->order[head];
+        for (int i = tree->sonsStart[cur]; i < tree->sonsStart[cur + 1]; ++i)
+        {
+            int son = tree->sons[i];
+            tree->dist[son] = tree->dist[cur] + 1;
+            tree->order[count++] = son;
+        }
     }
-    *minVal = curMin;
-    *maxVal = curMax;
-    return maxIdx;
+    return count;
 }
 
 /**
- * finds the diameter of the tree
+ * computes the branch lengths and the diameter of the tree. the vertices are ordered from the root once,
+ * then the subtree heights are computed sons first, by walking that order backwards, and the diameter is the
+ * longest path through any vertex: the sum of its two highest sons.
  * @param tree the tree
- * @param treeSize the tree size
- * @param maxIdx the vertex  in the end of the longest branch
- * @return the tree diameter
+ * @param metrics the results
  */
-int findDiameter(Vertex *tree, int treeSize, int maxIdx)
+void analyzeTree(Tree *tree, TreeMetrics *metrics)
 {
-    int diameter = 0;
-    bfs(&tree, treeSize, maxIdx);
-    for (int i = 0; i < treeSize; ++i)
+    metrics->root = getRoot(tree);
+    metrics->reached = 0;
+    metrics->minBranch = 0;
+    metrics->maxBranch = 0;
+    metrics->diameter = 0;
+    if (metrics->root == UNDEFINED_SIZE)
     {
-        if (tree[i].dist > diameter)
+        return;
+    }
+    int count = orderFromRoot(tree, metrics->root);
+    metrics->reached = count;
+    for (int k = count - 1; k >= 0; --k)
+    {
+        int cur = tree->order[k];
+        int highest = 0, second = 0;
+        for (int i = tree->sonsStart[cur]; i < tree->sonsStart[cur + 1]; ++i)
         {
-            diameter = tree[i].dist;
+            int sonHeight = tree->height[tree->sons[i]] + 1;
+            if (sonHeight > highest)
+            {
+                second = highest;
+                highest = sonHeight;
+            }
+            else if (sonHeight > second)
+            {
+                second = sonHeight;
+            }
+        }
+        tree->height[cur] = highest;
+        if (highest + second > metrics->diameter)
+        {
+            metrics->diameter = highest + second;
         }
     }
-    return diameter;
+    int curMin = tree->size + 1;
+    for (int i = 0; i < tree->size; ++i)
+    {
+        if ((tree->dist[i] != EQUAL) && (tree->dist[i] < curMin) && tree->isLeaf[i])
+        {
+            curMin = tree->dist[i];
+        }
+    }
+    metrics->minBranch = tree->size == MIN_TREE_SIZE ? 0 : curMin;
+    metrics->maxBranch = tree->height[metrics->root];
 }
 
 /**
  * finds the path between two nodes
  * @param tree the tree
- * @param treeSize the tree size
  * @param u the first node
  * @param v the second node
  */
-void findPath(Vertex *tree, int treeSize, int u, int v)
+void findPath(Tree *tree, int u, int v)
 {
     fprintf(stdout, SHORTEST_PATH_MSG, u, v);
-    bfs(&tree, treeSize, v);
+    bfs(tree, v);
     int curNode = u;
     if (u == v)
     {
@@ -450,36 +590,355 @@ void findPath(Vertex *tree, int treeSize, int u, int v)
     else
     {
         fprintf(stdout, "%d ", u);
-        while (tree[curNode].prev != v && tree[curNode].prev != UNDEFINED_SIZE)
+        while (tree->prev[curNode] != v && tree->prev[curNode] != UNDEFINED_SIZE)
         {
-            fprintf(stdout, "%d ", tree[curNode].prev);
-            curNode = tree[curNode].prev;
+            fprintf(stdout, "%d ", tree->prev[curNode]);
+            curNode = tree->prev[curNode];
         }
         fprintf(stdout, "%d\n", v);
     }
 }
 
 /**
- * prints the output of the program
+ * an index of the vertices under the root which finds the lowest common ancestor of two of them in O(log n),
+ * with O(n) memory. every vertex has a jump pointer to an ancestor, chosen so that the jumps have lengths of the
+ * form 2^k - 1 (Myers' skew binary jump pointers).
+ */
+typedef struct LcaIndex
+{
+    int *depth;
+    int *jump;
+    int *path;
+} LcaIndex;
+
+/**
+ * builds the lca index of the vertices analyzeTree ordered under the root
+ * @param tree the tree, after analyzeTree
+ * @param metrics the results of analyzeTree
+ * @param index the index to build
+ * @return 0 on success, 1 on failure
+ */
+int buildLcaIndex(const Tree *tree, const TreeMetrics *metrics, LcaIndex *index)
+{
+    index->depth = (int *) malloc(LCA_INT_ARRAYS * (size_t) tree->size * sizeof(int));
+    if (index->depth == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    index->jump = index->depth + tree->size;
+    index->path = index->jump + tree->size;
+    for (int i = 0; i < tree->size; ++i)
+    {
+        index->depth[i] = UNDEFINED_SIZE;
+    }
+    for (int k = 0; k < metrics->reached; ++k)
+    {
+        int cur = tree->order[k];
+        int parent = tree->parent[cur];
+        if (k == 0)
+        {
+            index->depth[cur] = EQUAL;
+            index->jump[cur] = cur;
+            continue;
+        }
+        int up = index->jump[parent];
+        index->depth[cur] = index->depth[parent] + 1;
+        if (index->depth[parent] - index->depth[up] == index->depth[up] - index->depth[index->jump[up]])
+        {
+            index->jump[cur] = index->jump[up];
+        }
+        else
+        {
+            index->jump[cur] = parent;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
  * @param tree the tree
- * @param treeSize the tree size
+ * @param index the lca index
+ * @param u a vertex under the root
+ * @param depth a depth not below u
+ * @return the ancestor of u in the given depth
+ */
+int ancestorAtDepth(const Tree *tree, const LcaIndex *index, int u, int depth)
+{
+    while (index->depth[u] > depth)
+    {
+        if (index->depth[index->jump[u]] >= depth)
+        {
+            u = index->jump[u];
+        }
+        else
+        {
+            u = tree->parent[u];
+        }
+    }
+    return u;
+}
+
+/**
+ * @param tree the tree
+ * @param index the lca index
+ * @param u a vertex under the root
+ * @param v a vertex under the root
+ * @return the lowest common ancestor of u and v
+ */
+int findLca(const Tree *tree, const LcaIndex *index, int u, int v)
+{
+    if (index->depth[u] > index->depth[v])
+    {
+        u = ancestorAtDepth(tree, index, u, index->depth[v]);
+    }
+    else
+    {
+        v = ancestorAtDepth(tree, index, v, index->depth[u]);
+    }
+    while (u != v)
+    {
+        if (index->jump[u] != index->jump[v])
+        {
+            u = index->jump[u];
+            v = index->jump[v];
+        }
+        else
+        {
+            u = tree->parent[u];
+            v = tree->parent[v];
+        }
+    }
+    return u;
+}
+
+/**
+ * prints the path between two vertices under the root, going up from u to their lowest common ancestor and
+ * down to v. prints the same as findPath without searching the tree.
+ * @param tree the tree
+ * @param index the lca index
  * @param u the first node
  * @param v the second node
  */
-void printOutput(Vertex *tree, int treeSize, int u, int v)
+void printLcaPath(const Tree *tree, const LcaIndex *index, int u, int v)
 {
-    int root = getRoot(tree, treeSize);
-    fprintf(stdout, "%s %d\n", ROOT_MSG, root);
-    fprintf(stdout, "%s %d\n", NODE_COUNT, treeSize);
-    int edges = (int) (treeSize) - 1;
+    int lca = findLca(tree, index, u, v);
+    int upLen = index->depth[u] - index->depth[lca] + 1;
+    int len = upLen + index->depth[v] - index->depth[lca];
+    for (int i = 0, cur = u; i < upLen; ++i, cur = tree->parent[cur])
+    {
+        index->path[i] = cur;
+    }
+    for (int i = len - 1, cur = v; i >= upLen; --i, cur = tree->parent[cur])
+    {
+        index->path[i] = cur;
+    }
+    fprintf(stdout, SHORTEST_PATH_MSG, u, v);
+    for (int i = 0; i < len - 1; ++i)
+    {
+        fprintf(stdout, "%d ", index->path[i]);
+    }
+    fprintf(stdout, "%d\n", v);
+}
+
+/**
+ * prints the output of the program. the paths between vertices under the root are found with the lca index,
+ * and with bfs otherwise (or if there is no memory for the index).
+ * @param tree the tree
+ * @param pairs the vertex pairs to print the paths between, PAIR_SIZE items each
+ * @param pairsCount the number of pairs
+ */
+void printOutput(Tree *tree, const int *pairs, int pairsCount)
+{
+    TreeMetrics metrics;
+    analyzeTree(tree, &metrics);
+    fprintf(stdout, "%s %d\n", ROOT_MSG, metrics.root);
+    fprintf(stdout, "%s %d\n", NODE_COUNT, tree->size);
+    int edges = tree->size - 1;
     fprintf(stdout, "%s %d\n", EDGE_COUNT, edges);
-    int minVal, maxVal;
-    int maxIdx = findMinMaxBranch(tree, treeSize, root, &minVal, &maxVal);
-    fprintf(stdout, "%s %d\n", MIN_BRANCH_LEN, minVal);
-    fprintf(stdout, "%s %d\n", MAX_BRANCH_LEN, maxVal);
-    int diameter = findDiameter(tree, treeSize, maxIdx);
-    fprintf(stdout, "%s %d\n", DIAMETER_LEN, diameter);
-    findPath(tree, treeSize, u, v);
+    fprintf(stdout, "%s %d\n", MIN_BRANCH_LEN, metrics.minBranch);
+    fprintf(stdout, "%s %d\n", MAX_BRANCH_LEN, metrics.maxBranch);
+    fprintf(stdout, "%s %d\n", DIAMETER_LEN, metrics.diameter);
+    LcaIndex index;
+    bool hasIndex = buildLcaIndex(tree, &metrics, &index) == EXIT_SUCCESS;
+    for (int i = 0; i < pairsCount; ++i)
+    {
+        int u = pairs[PAIR_SIZE * i];
+        int v = pairs[PAIR_SIZE * i + 1];
+        if (hasIndex && index.depth[u] != UNDEFINED_SIZE && index.depth[v] != UNDEFINED_SIZE)
+        {
+            printLcaPath(tree, &index, u, v);
+        }
+        else
+        {
+            findPath(tree, u, v);
+        }
+    }
+    if (hasIndex)
+    {
+        free(index.depth);
+    }
+}
+
+/**
+ * the state of the pairs parser between two blocks of the pairs file
+ */
+typedef struct PairsParser
+{
+    long number;
+    bool inNumber;
+    bool afterCr;
+    int numbers;
+    int line[PAIR_SIZE];
+    int *items;
+    int count;
+    int capacity;
+} PairsParser;
+
+/**
+ * ends the vertex just parsed on the current pairs line
+ * @param parser the parser
+ * @return 0 on success, 1 if the line already has two vertices
+ */
+int endPairVertex(PairsParser *parser)
+{
+    if (parser->numbers == PAIR_SIZE)
+    {
+        return EXIT_FAILURE;
+    }
+    parser->line[parser->numbers++] = (int) parser->number;
+    parser->number = 0;
+    parser->inNumber = false;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * ends a pairs line, which must hold exactly two vertices, and appends the pair
+ * @param parser the parser
+ * @return 0 on success, 1 on failure
+ */
+int endPairLine(PairsParser *parser)
+{
+    if (parser->inNumber && endPairVertex(parser) == EXIT_FAILURE)
+    {
+        return EXIT_FAILURE;
+    }
+    if (parser->numbers != PAIR_SIZE)
+    {
+        return EXIT_FAILURE;
+    }
+    if (parser->count == parser->capacity)
+    {
+        int capacity = parser->capacity * KEY_FACTOR;
+        int *grown = (int *) realloc(parser->items, PAIR_SIZE * (size_t) capacity * sizeof(int));
+        if (grown == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+        parser->items = grown;
+        parser->capacity = capacity;
+    }
+    parser->items[PAIR_SIZE * parser->count] = parser->line[0];
+    parser->items[PAIR_SIZE * parser->count + 1] = parser->line[1];
+    ++parser->count;
+    parser->numbers = 0;
+    parser->afterCr = false;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * validates and parses one block of the pairs file. every line is two vertices separated by spaces, each only
+ * digits and smaller than the tree size, like the vertices given on the command line. a line may end with
+ * "\r\n".
+ * @param parser the parser
+ * @param block the block
+ * @param len the block length
+ * @param treeSize the tree size
+ * @return 0 on success, 1 on failure
+ */
+int parsePairsBlock(PairsParser *parser, const char *block, size_t len, int treeSize)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        char c = block[i];
+        if (parser->afterCr && c != NEW_LINE)
+        {
+            return EXIT_FAILURE;
+        }
+        if (c >= INT_LOW && c <= INT_HI)
+        {
+            if (parser->numbers == PAIR_SIZE || pushDigit(&parser->number, c, treeSize - 1) == EXIT_FAILURE)
+            {
+                return EXIT_FAILURE;
+            }
+            parser->inNumber = true;
+        }
+        else if (c == SPACE_ASCII)
+        {
+            if (parser->inNumber && endPairVertex(parser) == EXIT_FAILURE)
+            {
+                return EXIT_FAILURE;
+            }
+        }
+        else if (c == NEW_LINE)
+        {
+            if (endPairLine(parser) == EXIT_FAILURE)
+            {
+                return EXIT_FAILURE;
+            }
+        }
+        else if (c == LINE_WIN)
+        {
+            parser->afterCr = true;
+        }
+        else
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * reads a file of vertex pairs, one pair per line. the file must hold at least one pair: an empty pairs file is
+ * invalid input, as is an empty line.
+ * @param fileName the pairs file
+ * @param treeSize the tree size
+ * @param pairs out parameter, the pairs, to be freed with free
+ * @param pairsCount out parameter, the number of pairs
+ * @return 1 if failed, 0 otherwise
+ */
+int parsePairs(const char *fileName, int treeSize, int **pairs, int *pairsCount)
+{
+    FILE *file = fopen(fileName, READ);
+    if (file == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    PairsParser parser = {0, false, false, 0, {0, 0}, NULL, 0, MIN_PAIRS_CAPACITY};
+    parser.items = (int *) malloc(PAIR_SIZE * (size_t) parser.capacity * sizeof(int));
+    char *block = (char *) malloc(BLOCK_SIZE);
+    int flag = block == NULL || parser.items == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+    bool endsWithLine = true;
+    size_t len;
+    while (flag == EXIT_SUCCESS && (len = fread(block, 1, BLOCK_SIZE, file)) > 0)
+    {
+        flag = parsePairsBlock(&parser, block, len, treeSize);
+        endsWithLine = block[len - 1] == NEW_LINE;
+    }
+    if (flag == EXIT_SUCCESS && (ferror(file) || (!endsWithLine && endPairLine(&parser)) || parser.count == 0))
+    {
+        flag = EXIT_FAILURE;
+    }
+    free(block);
+    fclose(file);
+    if (flag == EXIT_FAILURE)
+    {
+        free(parser.items);
+        return EXIT_FAILURE;
+    }
+    *pairs = parser.items;
+    *pairsCount = parser.count;
+    return EXIT_SUCCESS;
 }
 
 /**
@@ -519,30 +978,44 @@ int parseNodes(char *node, int treeSize)
  */
 int main(int argc, char *argv[])
 {
-    Vertex *tree = NULL;
-    int treeSize = 0, flag = 0;
+    Tree tree = {0, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, {NULL, 0, 0, 0}};
+    int flag = 0;
     if (argc != MAX_CLI_ARG)
     {
         errMsg(true);
         return EXIT_FAILURE;
     }
-    flag = parseFile(argv[FILE_IDX], &tree, &treeSize);
-    if ((flag == EXIT_FAILURE) || tree == NULL)
+    flag = parseFile(argv[FILE_IDX], &tree);
+    if (flag == EXIT_FAILURE)
     {
         errMsg(false);
-        freeEverything(&tree, treeSize);
+        freeEverything(&tree);
         return EXIT_FAILURE;
     }
-    setParent(&tree, treeSize);
-    int firstNode = parseNodes(argv[FIRST_NODE], treeSize);
-    int secondNode = parseNodes(argv[SECOND_NODE], treeSize);
-    if (firstNode == UNDEFINED_SIZE || secondNode == UNDEFINED_SIZE)
+    int pair[PAIR_SIZE];
+    int *pairs = pair;
+    int pairsCount = 1;
+    if (strcmp(argv[FIRST_NODE], PAIRS_FLAG) == EQUAL)
+    {
+        flag = parsePairs(argv[PAIRS_FILE_IDX], tree.size, &pairs, &pairsCount);
+    }
+    else
+    {
+        pair[0] = parseNodes(argv[FIRST_NODE], tree.size);
+        pair[1] = parseNodes(argv[SECOND_NODE], tree.size);
+        flag = pair[0] == UNDEFINED_SIZE || pair[1] == UNDEFINED_SIZE ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    if (flag == EXIT_FAILURE)
     {
         errMsg(false);
-        freeEverything(&tree, treeSize);
+        freeEverything(&tree);
         return EXIT_FAILURE;
     }
-    printOutput(tree, treeSize, firstNode, secondNode);
-    freeEverything(&tree, treeSize);
+    printOutput(&tree, pairs, pairsCount);
+    if (pairs != pair)
+    {
+        free(pairs);
+    }
+    freeEverything(&tree);
     return EXIT_SUCCESS;
 }
\ No newline at end of file
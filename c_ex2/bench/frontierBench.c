@@ -0,0 +1,227 @@
+/**
+ * @file frontierBench.c
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 27 Nov 2019
+ *
+ * @brief Benchmark of the bfs frontier of TreeAnalyzer.c
+ *
+ * @section DESCRIPTION
+ * Builds a random tree of 10^7 vertices (or argv[1]) and runs bfs from the root and from the last vertex, with
+ * the ring buffer frontier of the tree and with a linked queue which allocates every element, like the queue.h
+ * queue bfs used before. both run on the same tree, so only the queue differs.
+ * Output : the time per vertex of each version
+ */
+#define _GNU_SOURCE
+#include <time.h>
+#define main treeAnalyzerMain
+#include "../TreeAnalyzer.c"
+#undef main
+
+#define DEFAULT_VERTICES 10000000
+#define SEED 25
+#define RUNS 3
+#define NANOS_IN_SECOND 1e9
+
+/**
+ * an element of the linked queue
+ */
+typedef struct QueueItem
+{
+    int vertex;
+    struct QueueItem *next;
+} QueueItem;
+
+/**
+ * a queue which allocates every element, like the one of queue.h
+ */
+typedef struct LinkedQueue
+{
+    QueueItem *head;
+    QueueItem *tail;
+} LinkedQueue;
+
+/**
+ * adds a vertex at the tail of the queue
+ * @param queue the queue
+ * @param vertex the vertex
+ * @return 0 on failure, other on success
+ */
+int enqueueVertex(LinkedQueue *queue, int vertex)
+{
+    QueueItem *item = (QueueItem *) malloc(sizeof(QueueItem));
+    if (item == NULL)
+    {
+        return 0;
+    }
+    item->vertex = vertex;
+    item->next = NULL;
+    if (queue->tail == NULL)
+    {
+        queue->head = item;
+    }
+    else
+    {
+        queue->tail->next = item;
+    }
+    queue->tail = item;
+    return 1;
+}
+
+/**
+ * removes the vertex at the head of the queue
+ * @param queue the queue, not empty
+ * @return the vertex
+ */
+int dequeueVertex(LinkedQueue *queue)
+{
+    QueueItem *item = queue->head;
+    int vertex = item->vertex;
+    queue->head = item->next;
+    if (queue->head == NULL)
+    {
+        queue->tail = NULL;
+    }
+    free(item);
+    return vertex;
+}
+
+/**
+ * bfs exactly like the one of TreeAnalyzer.c, but with a linked queue
+ * @param tree the tree
+ * @param vertex the vertex we start from
+ */
+void linkedQueueBfs(Tree *tree, int vertex)
+{
+    for (int i = 0; i < tree->size; ++i)
+    {
+        tree->dist[i] = UNDEFINED_SIZE;
+        tree->prev[i] = UNDEFINED_SIZE;
+    }
+    tree->dist[vertex] = EQUAL;
+    LinkedQueue queue = {NULL, NULL};
+    enqueueVertex(&queue, vertex);
+    while (queue.head != NULL)
+    {
+        int curKey = dequeueVertex(&queue);
+        int keyParent = tree->parent[curKey];
+        if (keyParent != UNDEFINED_SIZE && tree->dist[keyParent] == UNDEFINED_SIZE)
+        {
+            tree->prev[keyParent] = curKey;
+            tree->dist[keyParent] = tree->dist[curKey] + 1;
+            enqueueVertex(&queue, keyParent);
+        }
+        for (int i = tree->sonsStart[curKey]; i < tree->sonsStart[curKey + 1]; ++i)
+        {
+            int curSonIdx = tree->sons[i];
+            if (tree->dist[curSonIdx] == UNDEFINED_SIZE)
+            {
+                tree->prev[curSonIdx] = curKey;
+                tree->dist[curSonIdx] = tree->dist[curKey] + 1;
+                enqueueVertex(&queue, curSonIdx);
+            }
+        }
+    }
+}
+
+/**
+ * @return the time of a monotonic clock in seconds
+ */
+double getSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / NANOS_IN_SECOND;
+}
+
+/**
+ * builds a random recursive tree: the parent of every vertex but the root 0 is a random earlier vertex
+ * @param tree the tree
+ * @param size the number of vertices
+ * @return 0 on success, 1 on failure
+ */
+int buildRandomTree(Tree *tree, int size)
+{
+    if (initTree(tree, size) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    unsigned int seed = SEED;
+    for (int i = 1; i < size; ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        tree->parent[i] = (int) ((seed >> 1u) % (unsigned int) i);
+    }
+    for (int i = 0; i <= size; ++i)
+    {
+        tree->sonsStart[i] = 0;
+    }
+    for (int i = 1; i < size; ++i)
+    {
+        ++tree->sonsStart[tree->parent[i] + 1];
+    }
+    for (int i = 0; i < size; ++i)
+    {
+        tree->sonsStart[i + 1] += tree->sonsStart[i];
+    }
+    // the order array is free here, it keeps where the next son of every vertex goes
+    for (int i = 0; i < size; ++i)
+    {
+        tree->order[i] = tree->sonsStart[i];
+    }
+    for (int i = 1; i < size; ++i)
+    {
+        tree->sons[tree->order[tree->parent[i]]++] = i;
+    }
+    for (int i = 0; i < size; ++i)
+    {
+        tree->isLeaf[i] = tree->sonsStart[i] == tree->sonsStart[i + 1];
+    }
+    tree->sonsCount = size - 1;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * times one version of bfs from a vertex
+ * @param name what is measured
+ * @param search the bfs
+ * @param tree the tree
+ * @param vertex the vertex to start from
+ * @return the sum of the distances, to check that both versions agree
+ */
+long long timeBfs(const char *name, void (*search)(Tree *, int), Tree *tree, int vertex)
+{
+    double best = 0;
+    for (int run = 0; run < RUNS; ++run)
+    {
+        double start = getSeconds();
+        search(tree, vertex);
+        double seconds = getSeconds() - start;
+        best = run == 0 || seconds < best ? seconds : best;
+    }
+    printf("%-44s %10.1f ns/vertex %9.3f s\n", name, best * NANOS_IN_SECOND / tree->size, best);
+    long long sum = 0;
+    for (int i = 0; i < tree->size; ++i)
+    {
+        sum += tree->dist[i];
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    int size = argc > 1 && atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_VERTICES;
+    Tree tree;
+    if (buildRandomTree(&tree, size) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    printf("bfs, %d vertices, best of %d runs\n", size, RUNS);
+    long long diff = timeBfs("from the root, ring buffer frontier", bfs, &tree, 0);
+    diff -= timeBfs("from the root, linked queue (before)", linkedQueueBfs, &tree, 0);
+    diff += timeBfs("from the last vertex, ring buffer frontier", bfs, &tree, size - 1);
+    diff -= timeBfs("from the last vertex, linked queue (before)", linkedQueueBfs, &tree, size - 1);
+    printf("%s\n", diff == 0 ? "same distances" : "DIFFERENT DISTANCES");
+    freeEverything(&tree);
+    return diff == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
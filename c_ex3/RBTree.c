@@ -12,426 +12,3008 @@
  * Process: checks if the user input is valid, and then build the tree
  * Output : a tree with the desired data types
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include "RBTree.h"
+#include "RBTreeExt.h"
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <assert.h>
 
 #define SUCCESS 1
 #define FAIL 0
 #define EQUAL 0
 
+#define DEFAULT_SLAB_NODES 4096
+#define MAX_THREADS 64
+#define LESS (-1)
+#define GREATER 1
+#define BPLUS_MAX_KEYS 32
+#define MAX_HEIGHT 128
+
 /**
- * constructs a new RBTree with the given CompareFunc.
- * comp: a function two compare two variables.
+ * a node which also knows how many nodes its subtree holds, used by trees built with ORDER_STATISTICS
  */
-RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc)
+typedef struct SizedNode
 {
-    RBTree *tree = NULL;
-    tree = (RBTree *) malloc(sizeof(RBTree));
-    if (tree == NULL)
+    Node node;
+    size_t size;
+} SizedNode;
+
+/**
+ * a block of nodes which is handed out by bump pointer, the slabs of a tree are chained so they can be
+ * released together. the nodes are nodeSize bytes apart since their layout depends on the tree.
+ */
+typedef struct Slab
+{
+    struct Slab *next;
+    size_t used;
+    size_t capacity;
+    void *nodes[];
+} Slab;
+
+/**
+ * the node allocator of a single tree. a node is the Node itself, then the subtree size (ORDER_STATISTICS), then
+ * the reference count (SNAPSHOTS) at refsOffset, then the inline key at keyOffset.
+ */
+typedef struct NodePool
+{
+    Slab *slabs;
+    Node *freeList;
+    size_t freeCount;
+    size_t slabNodes;
+    size_t nodeSize;
+    size_t keySize;
+    size_t refsOffset;
+    size_t keyOffset;
+    int withSizes;
+} NodePool;
+
+/**
+ * what a tree shares with its snapshots, guarded by the mutex. items removed from the tree while snapshots are
+ * open are retired here and freed when the last snapshot is freed. nodes which a freed snapshot was the last to
+ * use are returned here for the tree to reuse, and the slabs are kept here if the tree is freed first.
+ */
+typedef struct SnapshotGroup
+{
+    pthread_mutex_t mutex;
+    int openSnapshots;
+    int liveFreed;
+    FreeFunc freeFunc;
+    void **retired;
+    size_t retiredCount;
+    size_t retiredCapacity;
+    Node *returned;
+    Node *returnedTail;
+    size_t returnedCount;
+    NodePool pool;
+} SnapshotGroup;
+
+/**
+ * a node of the B+ tree engine. a node may hold one key too many until it is split. the nodes of every level
+ * are chained from left to right, which gives the in order scan over the leaves and a stack free teardown.
+ */
+typedef struct BPlusNode
+{
+    int isLeaf;
+    int count;
+    void *keys[BPLUS_MAX_KEYS + 1];
+    struct BPlusNode *children[BPLUS_MAX_KEYS + 2];
+    struct BPlusNode *next;
+} BPlusNode;
+
+/**
+ * the actual allocation behind every RBTree, the tree must stay the first member so we can cast between the two
+ */
+typedef struct PooledRBTree
+{
+    RBTree tree;
+    NodePool pool;
+    int isBPlus;
+    BPlusNode *bplusRoot;
+    int isThreadSafe;
+    pthread_rwlock_t lock;
+    int isSnapshot;
+    int isSharing;
+    SnapshotGroup *group;
+} PooledRBTree;
+
+/**
+ * a getter
+ * @param tree the tree
+ * @return the node pool of the tree
+ */
+NodePool *getPool(RBTree *tree)
+{
+    return &((PooledRBTree *) tree)->pool;
+}
+
+/**
+ * initializes a reader writer lock. glibc prefers readers by default, which lets a steady stream of lookups
+ * starve the writer, so we ask for writer preference where it is available.
+ * @param lock the lock
+ * @return 0 on success
+ */
+int initLock(pthread_rwlock_t *lock)
+{
+    pthread_rwlockattr_t attr;
+    if (pthread_rwlockattr_init(&attr) != 0)
+    {
+        return -1;
+    }
+#ifdef __GLIBC__
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    int ret = pthread_rwlock_init(lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    return ret;
+}
+
+/**
+ * takes the tree lock for reading, many threads may read at once. does nothing unless the tree was built with
+ * THREAD_SAFE. addToRBTree, containsRBTree, forEachRBTree, deleteFromRBTree and the range functions lock by
+ * themselves, cursors returned by the other functions must only be used while holding the lock. the lock is
+ * not recursive, so it must not be taken again by a thread which holds it.
+ * @param tree the tree
+ */
+void readLockRBTree(RBTree *tree)
+{
+    PooledRBTree *pooled = (PooledRBTree *) tree;
+    if (pooled->isThreadSafe)
+    {
+        pthread_rwlock_rdlock(&pooled->lock);
+    }
+}
+
+/**
+ * takes the tree lock for writing, writers are serialized and exclude the readers
+ * @param tree the tree
+ */
+void writeLockRBTree(RBTree *tree)
+{
+    PooledRBTree *pooled = (PooledRBTree *) tree;
+    if (pooled->isThreadSafe)
+    {
+        pthread_rwlock_wrlock(&pooled->lock);
+    }
+}
+
+/**
+ * releases the tree lock
+ * @param tree the tree
+ */
+void unlockRBTree(RBTree *tree)
+{
+    PooledRBTree *pooled = (PooledRBTree *) tree;
+    if (pooled->isThreadSafe)
+    {
+        pthread_rwlock_unlock(&pooled->lock);
+    }
+}
+
+/**
+ * a getter
+ * @param tree the tree
+ * @return 1 if the nodes of the tree keep their subtree size
+ */
+int hasSizes(RBTree *tree)
+{
+    return getPool(tree)->withSizes;
+}
+
+/**
+ * a getter, only valid for nodes of a tree built with ORDER_STATISTICS
+ * @param node the node, may be NULL
+ * @return the number of nodes in its subtree
+ */
+size_t getSize(Node *node)
+{
+    return node == NULL ? 0 : ((SizedNode *) node)->size;
+}
+
+/**
+ * recomputes the subtree size of a node from its children
+ * @param node a node of a tree built with ORDER_STATISTICS
+ */
+void updateSize(Node *node)
+{
+    ((SizedNode *) node)->size = 1 + getSize(node->left) + getSize(node->right);
+}
+
+/**
+ * recomputes the subtree sizes from node up to the root
+ * @param tree the tree
+ * @param node the lowest node whose subtree changed, may be NULL
+ */
+void updateSizesUp(RBTree *tree, Node *node)
+{
+    if (!hasSizes(tree))
+    {
+        return;
+    }
+    for (; node != NULL; node = node->parent)
+    {
+        updateSize(node);
+    }
+}
+
+/**
+ * constructs a new RBTree whose nodes are taken from slabs of the given size
+ * @param compFunc a function two compare two variables
+ * @param freeFunc a function to free the tree data
+ * @param slabNodes how many nodes each slab holds, 0 for the default
+ * @param flags ORDER_STATISTICS to keep subtree sizes for rank and select, THREAD_SAFE to guard the tree with a
+ * reader writer lock, SNAPSHOTS to keep a reference count in every node so snapshotRBTree can share them, or'ed
+ * together, 0 for none
+ * @return the new tree, NULL on failure
+ */
+RBTree *newRBTreeWithPool(CompareFunc compFunc, FreeFunc freeFunc, size_t slabNodes, int flags)
+{
+    PooledRBTree *pooled = NULL;
+    pooled = (PooledRBTree *) malloc(sizeof(PooledRBTree));
+    if (pooled == NULL)
     {
         return NULL;
     }
+    RBTree *tree = &pooled->tree;
     tree->root = NULL;
     tree->compFunc = compFunc;
     tree->freeFunc = freeFunc;
     tree->size = 0;
+    pooled->pool.slabs = NULL;
+    pooled->pool.freeList = NULL;
+    pooled->pool.freeCount = 0;
+    pooled->pool.slabNodes = slabNodes == 0 ? DEFAULT_SLAB_NODES : slabNodes;
+    pooled->pool.withSizes = (flags & ORDER_STATISTICS) != 0;
+    pooled->pool.nodeSize = pooled->pool.withSizes ? sizeof(SizedNode) : sizeof(Node);
+    pooled->pool.refsOffset = 0;
+    if (flags & SNAPSHOTS)
+    {
+        pooled->pool.refsOffset = pooled->pool.nodeSize;
+        pooled->pool.nodeSize += sizeof(size_t);
+    }
+    pooled->pool.keyOffset = pooled->pool.nodeSize;
+    pooled->pool.keySize = 0;
+    pooled->isSnapshot = FAIL;
+    pooled->isSharing = FAIL;
+    pooled->group = NULL;
+    pooled->isBPlus = FAIL;
+    pooled->bplusRoot = NULL;
+    pooled->isThreadSafe = (flags & THREAD_SAFE) != 0;
+    if (pooled->isThreadSafe && initLock(&pooled->lock) != 0)
+    {
+        free(pooled);
+        return NULL;
+    }
+    return tree;
+}
+
+/**
+ * constructs a new RBTree which keeps a copy of each item inside its node, so the comparisons on the way down
+ * don't need to chase the data into a separate allocation. meant for small fixed size keys, which are aligned
+ * to the size of a pointer. the tree does not take ownership of the added items, it copies them.
+ * the node itself is not made smaller: keeping the colour in a spare bit of a pointer or linking the nodes by
+ * 32 bit slab indices would change Node, which RBTree.h defines and the cursors hand out to the caller.
+ * @param compFunc a function two compare two variables
+ * @param keySize the size in bytes of every item
+ * @param flags the flags of newRBTreeWithPool
+ * @return the new tree, NULL on failure
+ */
+RBTree *newInlineRBTree(CompareFunc compFunc, size_t keySize, int flags)
+{
+    RBTree *tree = newRBTreeWithPool(compFunc, NULL, DEFAULT_SLAB_NODES, flags);
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    NodePool *pool = getPool(tree);
+    size_t nodeSize = pool->keyOffset + keySize;
+    pool->nodeSize = (nodeSize + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+    pool->keySize = keySize;
+    return tree;
+}
+
+/**
+ * constructs a new tree which keeps its items in a B+ tree with wide nodes instead of a red black tree. it is
+ * used through the same addToRBTree, containsRBTree, forEachRBTree and freeRBTree calls and also supports the
+ * range functions, rankRBTree and addBatchToRBTree. cursors (first, last, lower and upper bound, select), delete
+ * and snapshots need red black nodes: on a B+ tree they return NULL or 0 and set errno to ENOTSUP.
+ * @param compFunc a function two compare two variables
+ * @param freeFunc a function to free the tree data
+ * @return the new tree, NULL on failure
+ */
+RBTree *newBPlusRBTree(CompareFunc compFunc, FreeFunc freeFunc)
+{
+    RBTree *tree = newRBTree(compFunc, freeFunc);
+    if (tree != NULL)
+    {
+        ((PooledRBTree *) tree)->isBPlus = SUCCESS;
+    }
     return tree;
 }
 
+/**
+ * a getter
+ * @param tree the tree
+ * @return 1 if the tree uses the B+ tree engine
+ */
+int isBPlus(RBTree *tree)
+{
+    return ((PooledRBTree *) tree)->isBPlus;
+}
+
+/**
+ * turns down a call which only red black trees support. errno is set to ENOTSUP for a B+ tree, so the NULL or 0
+ * the caller gets can be told apart from an empty result.
+ * @param tree the tree
+ * @return 1 if the tree uses the B+ tree engine, 0 otherwise
+ */
+int rejectBPlus(RBTree *tree)
+{
+    if (tree != NULL && isBPlus(tree))
+    {
+        errno = ENOTSUP;
+        return SUCCESS;
+    }
+    return FAIL;
+}
+
+/**
+ * frees an item that left the tree, items kept inside the node belong to the node
+ * @param tree the tree
+ * @param data the item
+ */
+void freeData(RBTree *tree, void *data)
+{
+    if (getPool(tree)->keySize == 0)
+    {
+        tree->freeFunc(data);
+    }
+}
+
+/**
+ * constructs a new RBTree with the given CompareFunc.
+ * comp: a function two compare two variables.
+ */
+RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc)
+{
+    return newRBTreeWithPool(compFunc, freeFunc, DEFAULT_SLAB_NODES, 0);
+}
+
+/**
+ * frees an item that was removed from the tree, or retires it if a snapshot may still see it
+ * @param tree the tree, with the group mutex held if it has snapshots
+ * @param data the item
+ */
+void retireData(RBTree *tree, void *data)
+{
+    SnapshotGroup *group = ((PooledRBTree *) tree)->group;
+    if (getPool(tree)->keySize != 0)
+    {
+        return;
+    }
+    if (group == NULL || group->openSnapshots == 0)
+    {
+        tree->freeFunc(data);
+        return;
+    }
+    if (group->retiredCount == group->retiredCapacity)
+    {
+        size_t capacity = group->retiredCapacity == 0 ? DEFAULT_SLAB_NODES : 2 * group->retiredCapacity;
+        void **retired = (void **) realloc(group->retired, capacity * sizeof(void *));
+        if (retired != NULL)
+        {
+            group->retired = retired;
+            group->retiredCapacity = capacity;
+        }
+    }
+    // if there is no room the item is leaked, freeing it could pull it from under a snapshot
+    if (group->retiredCount < group->retiredCapacity)
+    {
+        group->retired[group->retiredCount++] = data;
+    }
+}
+
+/**
+ * a getter
+ * @param pool the pool the slab belongs to
+ * @param slab the slab
+ * @param i the index of the node in the slab
+ * @return the node
+ */
+Node *getSlabNode(NodePool *pool, Slab *slab, size_t i)
+{
+    return (Node *) ((char *) slab->nodes + i * pool->nodeSize);
+}
+
+/**
+ * starts a new slab, the rest of the current one is left unused
+ * @param pool the tree pool
+ * @param capacity how many nodes the slab holds
+ * @return 0 on failure, other on success
+ */
+int addSlab(NodePool *pool, size_t capacity)
+{
+    Slab *slab = (Slab *) malloc(sizeof(Slab) + capacity * pool->nodeSize);
+    if (slab == NULL)
+    {
+        return FAIL;
+    }
+    slab->used = 0;
+    slab->capacity = capacity;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    return SUCCESS;
+}
+
+/**
+ * takes a node from the pool, a released node is reused before a new one is cut from the slab
+ * @param pool the tree pool
+ * @return an uninitialized node, NULL on failure
+ */
+Node *allocNode(NodePool *pool)
+{
+    Node *node = pool->freeList;
+    if (node != NULL)
+    {
+        pool->freeList = node->left;
+        --pool->freeCount;
+        return node;
+    }
+    if ((pool->slabs == NULL || pool->slabs->used == pool->slabs->capacity) && !addSlab(pool, pool->slabNodes))
+    {
+        return NULL;
+    }
+    return getSlabNode(pool, pool->slabs, pool->slabs->used++);
+}
+
+/**
+ * makes sure the next count nodes can be taken from the pool without allocating
+ * @param pool the tree pool
+ * @param count the number of nodes
+ * @return 0 on failure, other on success
+ */
+int reserveNodes(NodePool *pool, size_t count)
+{
+    size_t spare = pool->freeCount;
+    if (pool->slabs != NULL)
+    {
+        spare += pool->slabs->capacity - pool->slabs->used;
+    }
+    return spare >= count || addSlab(pool, count > pool->slabNodes ? count : pool->slabNodes);
+}
+
+/**
+ * gives a node back to the pool, its data is cleared so a slab scan can tell it is not in the tree
+ * @param pool the tree pool
+ * @param node the node to release
+ */
+void releaseNode(NodePool *pool, Node *node)
+{
+    node->data = NULL;
+    node->left = pool->freeList;
+    pool->freeList = node;
+    ++pool->freeCount;
+}
+
+/**
+ * frees the slabs of the pool without touching the data the nodes hold
+ * @param pool the tree pool
+ */
+void releaseSlabs(NodePool *pool)
+{
+    Slab *slab = pool->slabs;
+    while (slab != NULL)
+    {
+        Slab *next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    pool->slabs = NULL;
+    pool->freeList = NULL;
+    pool->freeCount = 0;
+}
+
+/**
+ * a getter, only valid for nodes of a tree built with SNAPSHOTS
+ * @param pool the pool the node belongs to
+ * @param node the node
+ * @return the number of links to the node, from parents in the tree or its snapshots and from their roots
+ */
+size_t *getRefs(NodePool *pool, Node *node)
+{
+    return (size_t *) ((char *) node + pool->refsOffset);
+}
+
 /**
  * created a new node
+ * @param pool the pool the node is taken from
  * @param data the data which the node holds
  * @return a new node
  */
-Node *newNode(void *data)
+Node *newNode(NodePool *pool, void *data)
 {
-    Node *node = NULL;
-    node = (Node *) malloc(sizeof(Node));
+    Node *node = allocNode(pool);
 
     if (node == NULL)
     {
         return NULL;
     }
     node->data = data;
+    if (pool->keySize != 0)
+    {
+        node->data = (char *) node + pool->keyOffset;
+        memcpy(node->data, data, pool->keySize);
+    }
+    if (pool->refsOffset != 0)
+    {
+        *getRefs(pool, node) = 1;
+    }
     node->color = RED;
     node->left = NULL;
     node->right = NULL;
     node->parent = NULL;
+    if (pool->withSizes)
+    {
+        ((SizedNode *) node)->size = 1;
+    }
     return node;
 }
 
 /**
- * rotates the tree nodes to the right as we saw in DAST
- * @param node the node which we need to fix its position
+ * builds a perfectly balanced subtree from the sorted items between lo (inclusive) and hi (exclusive). every
+ * level above redDepth is full, so colouring that level red and the rest black gives a valid RB tree
+ * @param pool the pool the nodes are taken from
+ * @param items the sorted items
+ * @param lo the first item of the subtree
+ * @param hi one past the last item of the subtree
+ * @param depth the depth of the subtree root
+ * @param redDepth the depth of the deepest level
+ * @param isOk set to 0 if a node could not be allocated
+ * @return the subtree root, NULL if the range is empty or on allocation failure
  */
-void rotateRight(Node *node)
+Node *buildBalanced(NodePool *pool, void **items, size_t lo, size_t hi, int depth, int redDepth, int *isOk)
 {
-    Node *left = node->left;
-    Node *parent = node->parent;
-    if (left->right != NULL)
+    if (lo >= hi)
     {
-        left->right->parent = node;
+        return NULL;
     }
-    node->left = left->right;
-    node->parent = left;
-    left->right = node;
-    left->parent = parent;
-    if (parent != NULL)
+    size_t mid = lo + (hi - lo) / 2;
+    Node *node = newNode(pool, items[mid]);
+    if (node == NULL)
     {
-        if (parent->right == node)
-        {
-            parent->right = left;
+        *isOk = FAIL;
+        return NULL;
+    }
+    node->color = (depth == redDepth && depth != 0) ? RED : BLACK;
+    node->left = buildBalanced(pool, items, lo, mid, depth + 1, redDepth, isOk);
+    node->right = buildBalanced(pool, items, mid + 1, hi, depth + 1, redDepth, isOk);
+    if (node->left != NULL)
+    {
+        node->left->parent = node;
+    }
+    if (node->right != NULL)
+    {
+        node->right->parent = node;
+    }
+    if (pool->withSizes)
+    {
+        ((SizedNode *) node)->size = hi - lo;
+    }
+    return node;
+}
+
+/**
+ * fills an empty red black tree with sorted items in linear time, no comparisons and no rotations are made. the
+ * nodes are built in fresh slabs which replace the old ones only on success, so the tree is rebuilt from its own
+ * items plus new ones the same way (the old nodes are dropped without freeing their data).
+ * @param tree an empty tree, or one without open snapshots which is rebuilt
+ * @param items strictly ascending items
+ * @param count the number of items
+ * @return 0 on failure (the tree is left as it was), other on success
+ */
+int buildFromSorted(RBTree *tree, void **items, size_t count)
+{
+    int redDepth = 0;
+    for (size_t n = count; n > 1; n /= 2)
+    {
+        ++redDepth;
+    }
+    NodePool *pool = getPool(tree);
+    NodePool fresh = *pool;
+    fresh.slabs = NULL;
+    fresh.freeList = NULL;
+    fresh.freeCount = 0;
+    int isOk = SUCCESS;
+    Node *root = buildBalanced(&fresh, items, 0, count, 0, redDepth, &isOk);
+    if (!isOk)
+    {
+        releaseSlabs(&fresh);
+        return FAIL;
+    }
+    releaseSlabs(pool);
+    *pool = fresh;
+    SnapshotGroup *group = ((PooledRBTree *) tree)->group;
+    if (group != NULL)
+    {
+        // the nodes given back by freed snapshots were in the old slabs
+        pthread_mutex_lock(&group->mutex);
+        group->returned = NULL;
+        group->returnedTail = NULL;
+        group->returnedCount = 0;
+        pthread_mutex_unlock(&group->mutex);
+    }
+    tree->root = root;
+    tree->size = count;
+    return SUCCESS;
+}
+
+/**
+ * created a copy of a node with the same item, colour and subtree size but no links
+ * @param pool the pool the copy is taken from
+ * @param node the node to copy
+ * @return the copy, NULL on failure
+ */
+Node *copyNode(NodePool *pool, Node *node)
+{
+    Node *copy = newNode(pool, node->data);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    copy->color = node->color;
+    if (pool->withSizes)
+    {
+        ((SizedNode *) copy)->size = getSize(node);
+    }
+    return copy;
+}
+
+/**
+ * makes sure a node of the tree is not shared with a snapshot before it is changed, by copying it if it is. the
+ * copy takes the place of the node under its parent, which must not be shared itself (or the node is the root),
+ * and takes over its children, which become shared by the node and the copy. the parent pointers belong to the
+ * tree: the children now point at the copy, and the snapshots never follow a parent pointer. the copy is taken
+ * from the nodes beginWrite reserved (maxCopies of them), so it can't fail: the callers are in the middle of a
+ * fix-up and could not undo it. anyone changing a shared tree must reserve the nodes it may copy first.
+ * @param tree the tree, between beginWrite and endWrite
+ * @param node the node, may be NULL
+ * @return the node, or its copy if it was shared
+ */
+Node *unshareNode(RBTree *tree, Node *node)
+{
+    NodePool *pool = getPool(tree);
+    if (node == NULL || !((PooledRBTree *) tree)->isSharing || *getRefs(pool, node) == 1)
+    {
+        return node;
+    }
+    Node *copy = copyNode(pool, node);
+    assert(copy != NULL);
+    copy->parent = node->parent;
+    copy->left = node->left;
+    copy->right = node->right;
+    if (copy->left != NULL)
+    {
+        ++*getRefs(pool, copy->left);
+        copy->left->parent = copy;
+    }
+    if (copy->right != NULL)
+    {
+        ++*getRefs(pool, copy->right);
+        copy->right->parent = copy;
+    }
+    --*getRefs(pool, node);
+    if (copy->parent == NULL)
+    {
+        tree->root = copy;
+    }
+    else if (copy->parent->left == node)
+    {
+        copy->parent->left = copy;
+    }
+    else
+    {
+        copy->parent->right = copy;
+    }
+    return copy;
+}
+
+/**
+ * unshares every node from the root down to node, top down so each parent is unshared before its child. this is
+ * the path copying of a change: only the way to the change is copied, the rest stays shared with the snapshots.
+ * @param tree the tree, between beginWrite and endWrite
+ * @param node a node of the tree
+ * @return the node, or its copy if it was shared
+ */
+Node *unsharePath(RBTree *tree, Node *node)
+{
+    if (!((PooledRBTree *) tree)->isSharing)
+    {
+        return node;
+    }
+    Node *path[MAX_HEIGHT + 1];
+    int depth = 0;
+    for (Node *cur = node; cur != NULL; cur = cur->parent)
+    {
+        path[depth++] = cur;
+    }
+    while (depth > 0)
+    {
+        node = unshareNode(tree, path[--depth]);
+    }
+    return node;
+}
+
+/**
+ * a bound on the nodes a single add or delete may copy: the path to the change, plus the uncle of every level
+ * on insert, or the sibling and nephews of the levels the delete fix-up visits
+ * @param size the number of items in the tree
+ * @return the bound
+ */
+size_t maxCopies(size_t size)
+{
+    size_t height = 2;
+    for (size_t n = size + 1; n > 1; n /= 2)
+    {
+        height += 2;
+    }
+    return 5 * height + 4;
+}
+
+/**
+ * must be called before a red black tree is changed, and endWrite after it. snapshots are read only. while a
+ * tree has open snapshots its changes copy the shared nodes they touch (see unshareNode), under the group mutex
+ * so the reference counts stay consistent with snapshots freed meanwhile. the nodes for the copies are reserved
+ * first, so a change never fails half way.
+ * @param tree the tree, locked for writing
+ * @return 0 if the tree can't be changed, other otherwise (call endWrite then)
+ */
+int beginWrite(RBTree *tree)
+{
+    PooledRBTree *pooled = (PooledRBTree *) tree;
+    SnapshotGroup *group = pooled->group;
+    if (pooled->isSnapshot)
+    {
+        return FAIL;
+    }
+    if (group == NULL)
+    {
+        return SUCCESS;
+    }
+    pthread_mutex_lock(&group->mutex);
+    if (group->returned != NULL)
+    {
+        group->returnedTail->left = pooled->pool.freeList;
+        pooled->pool.freeList = group->returned;
+        pooled->pool.freeCount += group->returnedCount;
+        group->returned = NULL;
+        group->returnedTail = NULL;
+        group->returnedCount = 0;
+    }
+    pooled->isSharing = group->openSnapshots > 0;
+    if (pooled->isSharing && !reserveNodes(&pooled->pool, maxCopies(tree->size)))
+    {
+        pooled->isSharing = FAIL;
+        pthread_mutex_unlock(&group->mutex);
+        return FAIL;
+    }
+    return SUCCESS;
+}
+
+/**
+ * ends a change started by beginWrite
+ * @param tree the tree
+ */
+void endWrite(RBTree *tree)
+{
+    PooledRBTree *pooled = (PooledRBTree *) tree;
+    if (pooled->group != NULL)
+    {
+        pooled->isSharing = FAIL;
+        pthread_mutex_unlock(&pooled->group->mutex);
+    }
+}
+
+/**
+ * a getter
+ * @param tree the tree, locked for writing so no snapshot can be taken meanwhile
+ * @return 1 if snapshots of the tree are open
+ */
+int hasOpenSnapshots(RBTree *tree)
+{
+    SnapshotGroup *group = ((PooledRBTree *) tree)->group;
+    if (group == NULL)
+    {
+        return FAIL;
+    }
+    pthread_mutex_lock(&group->mutex);
+    int ret = group->openSnapshots > 0;
+    pthread_mutex_unlock(&group->mutex);
+    return ret;
+}
+
+/**
+ * takes a read only snapshot of the tree in O(1): the snapshot shares the root, whose reference count goes up.
+ * from then on every change to the tree copies the nodes on its path that are still shared, O(log n) extra
+ * nodes per change instead of a copy of the whole tree, and frees nothing a snapshot may see. a changed node is
+ * replaced by its copy, so the cursors of the tree are invalidated by changes while a snapshot is open. the
+ * snapshot is read with the usual functions and needs no locking. it does not use the parent pointers, which
+ * belong to the tree, so the functions that return cursors fail on it. it is freed with freeRBTree in any
+ * order with the tree, and items removed from the tree stay alive until the snapshots which may see them are
+ * freed.
+ * @param tree a red black tree built with SNAPSHOTS, which is not a snapshot itself
+ * @return the snapshot, NULL on failure, or with errno set to ENOTSUP for a B+ tree or a tree built without
+ * SNAPSHOTS
+ */
+RBTree *snapshotRBTree(RBTree *tree)
+{
+    if (tree == NULL || rejectBPlus(tree) || ((PooledRBTree *) tree)->isSnapshot)
+    {
+        return NULL;
+    }
+    PooledRBTree *live = (PooledRBTree *) tree;
+    if (live->pool.refsOffset == 0)
+    {
+        errno = ENOTSUP;
+        return NULL;
+    }
+    PooledRBTree *snapshot = (PooledRBTree *) malloc(sizeof(PooledRBTree));
+    if (snapshot == NULL)
+    {
+        return NULL;
+    }
+    writeLockRBTree(tree);
+    if (live->group == NULL)
+    {
+        live->group = (SnapshotGroup *) calloc(1, sizeof(SnapshotGroup));
+        if (live->group == NULL || pthread_mutex_init(&live->group->mutex, NULL) != 0)
+        {
+            free(live->group);
+            live->group = NULL;
+            unlockRBTree(tree);
+            free(snapshot);
+            return NULL;
+        }
+        live->group->freeFunc = tree->freeFunc;
+    }
+    *snapshot = *live;
+    snapshot->isSnapshot = SUCCESS;
+    snapshot->isThreadSafe = FAIL;
+    snapshot->pool.slabs = NULL;
+    snapshot->pool.freeList = NULL;
+    snapshot->pool.freeCount = 0;
+    pthread_mutex_lock(&live->group->mutex);
+    ++live->group->openSnapshots;
+    if (tree->root != NULL)
+    {
+        ++*getRefs(&live->pool, tree->root);
+    }
+    pthread_mutex_unlock(&live->group->mutex);
+    unlockRBTree(tree);
+    return &snapshot->tree;
+}
+
+/**
+ * lets go of the nodes of a snapshot: the reference count of its root goes down, and every node which is no
+ * longer used by anyone is returned to the group, which lets go of its children in turn
+ * @param snapshot the snapshot, with the group mutex held
+ */
+void dropNodes(PooledRBTree *snapshot)
+{
+    SnapshotGroup *group = snapshot->group;
+    NodePool *pool = &snapshot->pool;
+    Node *stack[MAX_HEIGHT + 2];
+    int top = 0;
+    if (snapshot->tree.root != NULL)
+    {
+        stack[top++] = snapshot->tree.root;
+    }
+    while (top > 0)
+    {
+        Node *node = stack[--top];
+        if (--*getRefs(pool, node) > 0)
+        {
+            continue;
+        }
+        if (node->left != NULL)
+        {
+            stack[top++] = node->left;
+        }
+        if (node->right != NULL)
+        {
+            stack[top++] = node->right;
+        }
+        node->data = NULL;
+        node->left = group->returned;
+        group->returned = node;
+        if (group->returnedTail == NULL)
+        {
+            group->returnedTail = node;
+        }
+        ++group->returnedCount;
+    }
+}
+
+/**
+ * frees a snapshot, the last open snapshot also frees the retired items, and the slabs if the tree is gone
+ * @param snapshot the snapshot
+ */
+void freeSnapshot(PooledRBTree *snapshot)
+{
+    SnapshotGroup *group = snapshot->group;
+    pthread_mutex_lock(&group->mutex);
+    if (!group->liveFreed)
+    {
+        dropNodes(snapshot);
+    }
+    int isLast = --group->openSnapshots == 0;
+    void **retired = isLast ? group->retired : NULL;
+    size_t retiredCount = isLast ? group->retiredCount : 0;
+    if (isLast)
+    {
+        group->retired = NULL;
+        group->retiredCount = 0;
+        group->retiredCapacity = 0;
+    }
+    int isGroupDone = isLast && group->liveFreed;
+    pthread_mutex_unlock(&group->mutex);
+    for (size_t i = 0; i < retiredCount; ++i)
+    {
+        group->freeFunc(retired[i]);
+    }
+    free(retired);
+    if (isGroupDone)
+    {
+        releaseSlabs(&group->pool);
+        pthread_mutex_destroy(&group->mutex);
+        free(group);
+    }
+    free(snapshot);
+}
+
+/**
+ * constructs a new RBTree from items which are already in ascending order. the tree owns the items on success.
+ * @param compFunc a function two compare two variables
+ * @param freeFunc a function to free the tree data
+ * @param items strictly ascending items, none of them NULL
+ * @param count the number of items
+ * @return the new tree, NULL on failure or if the items are not strictly ascending
+ */
+RBTree *newRBTreeFromSorted(CompareFunc compFunc, FreeFunc freeFunc, void **items, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (items[i] == NULL || (i > 0 && compFunc(items[i - 1], items[i]) >= EQUAL))
+        {
+            return NULL;
+        }
+    }
+    RBTree *tree = newRBTree(compFunc, freeFunc);
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    if (!buildFromSorted(tree, items, count))
+    {
+        free((PooledRBTree *) tree);
+        return NULL;
+    }
+    return tree;
+}
+
+/**
+ * merges two neighbouring sorted runs, from[lo..mid) and from[mid..hi), into to[lo..hi). equal items keep
+ * their order.
+ * @param from the runs
+ * @param to where the merged run is written
+ * @param lo the start of the first run
+ * @param mid the start of the second run
+ * @param hi the end of the second run
+ * @param compFunc the compare function
+ */
+void mergeRuns(void **from, void **to, size_t lo, size_t mid, size_t hi, CompareFunc compFunc)
+{
+    size_t i = lo, j = mid, k = lo;
+    while (i < mid && j < hi)
+    {
+        to[k++] = compFunc(from[j], from[i]) < EQUAL ? from[j++] : from[i++];
+    }
+    while (i < mid)
+    {
+        to[k++] = from[i++];
+    }
+    while (j < hi)
+    {
+        to[k++] = from[j++];
+    }
+}
+
+/**
+ * stable bottom up merge sort of an array of items, we can't use qsort since it has no way to pass compFunc
+ * @param items the items to sort
+ * @param count the number of items
+ * @param compFunc the compare function
+ * @return 0 on allocation failure, other on success
+ */
+int sortItems(void **items, size_t count, CompareFunc compFunc)
+{
+    if (count < 2)
+    {
+        return SUCCESS;
+    }
+    void **buffer = (void **) malloc(count * sizeof(void *));
+    if (buffer == NULL)
+    {
+        return FAIL;
+    }
+    void **from = items;
+    void **to = buffer;
+    for (size_t width = 1; width < count; width *= 2)
+    {
+        for (size_t lo = 0; lo < count; lo += 2 * width)
+        {
+            size_t mid = lo + width < count ? lo + width : count;
+            size_t hi = mid + width < count ? mid + width : count;
+            mergeRuns(from, to, lo, mid, hi, compFunc);
+        }
+        void **tmp = from;
+        from = to;
+        to = tmp;
+    }
+    if (from != items)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            items[i] = from[i];
+        }
+    }
+    free(buffer);
+    return SUCCESS;
+}
+
+/**
+ * orders pointers by their address
+ * @param a a pointer to the first pointer
+ * @param b a pointer to the second pointer
+ * @return less than, equal to or greater than 0 like strcmp
+ */
+int comparePointers(const void *a, const void *b)
+{
+    uintptr_t first = (uintptr_t) *(void *const *) a;
+    uintptr_t second = (uintptr_t) *(void *const *) b;
+    return (first > second) - (first < second);
+}
+
+/**
+ * frees rejected items, an item which was given more than once is freed only once
+ * @param items the items, reordered by address
+ * @param count the number of items
+ * @param freeFunc the free function
+ */
+void freeDistinct(void **items, size_t count, FreeFunc freeFunc)
+{
+    qsort(items, count, sizeof(void *), comparePointers);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i == 0 || items[i] != items[i - 1])
+        {
+            freeFunc(items[i]);
+        }
+    }
+}
+
+/**
+ * constructs a new RBTree from items in any order. the items are reordered in place, and items which are equal
+ * to an earlier one are freed with freeFunc just like they would have been rejected by addToRBTree. the same
+ * pointer may appear more than once: it is never freed if it is the kept item, and freed once otherwise. the
+ * tree owns the kept items on success.
+ * @param compFunc a function two compare two variables
+ * @param freeFunc a function to free the tree data
+ * @param items the items, none of them NULL
+ * @param count the number of items
+ * @return the new tree, NULL on failure (nothing is freed in that case)
+ */
+RBTree *newRBTreeFromArray(CompareFunc compFunc, FreeFunc freeFunc, void **items, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (items[i] == NULL)
+        {
+            return NULL;
+        }
+    }
+    if (!sortItems(items, count, compFunc))
+    {
+        return NULL;
+    }
+    void **unique = (void **) malloc((count == 0 ? 1 : count) * sizeof(void *));
+    if (unique == NULL)
+    {
+        return NULL;
+    }
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (uniqueCount == 0 || compFunc(unique[uniqueCount - 1], items[i]) != EQUAL)
+        {
+            unique[uniqueCount++] = items[i];
+        }
+    }
+    RBTree *tree = newRBTreeFromSorted(compFunc, freeFunc, unique, uniqueCount);
+    if (tree != NULL && uniqueCount != count)
+    {
+        size_t next = 0;
+        size_t rejectedCount = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (next < uniqueCount && items[i] == unique[next])
+            {
+                ++next;
+            }
+            else if (items[i] != unique[next - 1])
+            {
+                items[rejectedCount++] = items[i];
+            }
+        }
+        freeDistinct(items, rejectedCount, freeFunc);
+    }
+    free(unique);
+    return tree;
+}
+
+/**
+ * created a new B+ tree node
+ * @param isLeaf 1 for a leaf
+ * @return the node, NULL on failure
+ */
+BPlusNode *newBPlusNode(int isLeaf)
+{
+    BPlusNode *node = (BPlusNode *) malloc(sizeof(BPlusNode));
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    node->isLeaf = isLeaf;
+    node->count = 0;
+    node->next = NULL;
+    return node;
+}
+
+/**
+ * binary search in a B+ tree node
+ * @param node the node
+ * @param data the item we look for
+ * @param compFunc the tree compare function
+ * @param inclusive if not 0 keys equal to data are counted as well
+ * @return the number of keys in the node which are less than data
+ */
+int bplusSearch(BPlusNode *node, void *data, CompareFunc compFunc, int inclusive)
+{
+    int lo = 0, hi = node->count;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        int comp = compFunc(node->keys[mid], data);
+        if (comp < EQUAL || (comp == EQUAL && inclusive))
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * walks down to the leaf that may hold data
+ * @param tree the tree
+ * @param data the item
+ * @param path if not NULL, filled with the internal nodes on the way
+ * @param pathIdx if not NULL, filled with the child index taken in each of them
+ * @param depth if not NULL, set to the number of internal nodes on the way
+ * @return the leaf, NULL if the tree is empty
+ */
+BPlusNode *bplusFindLeaf(RBTree *tree, void *data, BPlusNode **path, int *pathIdx, int *depth)
+{
+    BPlusNode *cur = ((PooledRBTree *) tree)->bplusRoot;
+    int level = 0;
+    while (cur != NULL && !cur->isLeaf)
+    {
+        int idx = bplusSearch(cur, data, tree->compFunc, SUCCESS);
+        if (path != NULL)
+        {
+            path[level] = cur;
+            pathIdx[level] = idx;
+        }
+        ++level;
+        cur = cur->children[idx];
+    }
+    if (depth != NULL)
+    {
+        *depth = level;
+    }
+    return cur;
+}
+
+/**
+ * splits a node which holds one key too many into two halves
+ * @param node the full node
+ * @param right an empty node which becomes the right half
+ * @param separator set to the key which goes up to the parent
+ */
+void bplusSplit(BPlusNode *node, BPlusNode *right, void **separator)
+{
+    right->isLeaf = node->isLeaf;
+    int mid = node->count / 2;
+    if (node->isLeaf)
+    {
+        right->count = node->count - mid;
+        memcpy(right->keys, node->keys + mid, right->count * sizeof(void *));
+        *separator = right->keys[0];
+    }
+    else
+    {
+        right->count = node->count - mid - 1;
+        memcpy(right->keys, node->keys + mid + 1, right->count * sizeof(void *));
+        memcpy(right->children, node->children + mid + 1, (right->count + 1) * sizeof(BPlusNode *));
+        *separator = node->keys[mid];
+    }
+    node->count = mid;
+    right->next = node->next;
+    node->next = right;
+}
+
+/**
+ * inserts a key (and the child to its right, for internal nodes) at a position of a node
+ * @param node the node
+ * @param idx the position
+ * @param key the key
+ * @param rightChild the child which follows the key, ignored for leaves
+ */
+void bplusInsertAt(BPlusNode *node, int idx, void *key, BPlusNode *rightChild)
+{
+    memmove(node->keys + idx + 1, node->keys + idx, (node->count - idx) * sizeof(void *));
+    node->keys[idx] = key;
+    if (!node->isLeaf)
+    {
+        memmove(node->children + idx + 2, node->children + idx + 1, (node->count - idx) * sizeof(BPlusNode *));
+        node->children[idx + 1] = rightChild;
+    }
+    ++node->count;
+}
+
+/**
+ * add an item to a B+ tree, full nodes are split on the way back up
+ * @param tree the tree
+ * @param data the item
+ * @return 0 on failure (or if the item is already in the tree), other on success
+ */
+int bplusAdd(RBTree *tree, void *data)
+{
+    PooledRBTree *pooled = (PooledRBTree *) tree;
+    BPlusNode *path[sizeof(size_t) * 8];
+    int pathIdx[sizeof(size_t) * 8];
+    int depth = 0;
+    BPlusNode *leaf = bplusFindLeaf(tree, data, path, pathIdx, &depth);
+    if (leaf == NULL)
+    {
+        leaf = newBPlusNode(SUCCESS);
+        if (leaf == NULL)
+        {
+            return FAIL;
+        }
+        pooled->bplusRoot = leaf;
+    }
+    int idx = bplusSearch(leaf, data, tree->compFunc, FAIL);
+    if (idx < leaf->count && tree->compFunc(leaf->keys[idx], data) == EQUAL)
+    {
+        return FAIL;
+    }
+    // every full node on the way up splits, so their new halves are allocated before anything changes
+    BPlusNode *spare[sizeof(size_t) * 8 + 2];
+    int spareCount = 0;
+    BPlusNode *full = leaf;
+    for (int level = depth; full != NULL && full->count == BPLUS_MAX_KEYS; --level)
+    {
+        ++spareCount;
+        full = level > 0 ? path[level - 1] : NULL;
+    }
+    if (full == NULL) // the root splits as well and a new root is needed
+    {
+        ++spareCount;
+    }
+    for (int i = 0; i < spareCount; ++i)
+    {
+        spare[i] = newBPlusNode(FAIL);
+        if (spare[i] == NULL)
+        {
+            while (i > 0)
+            {
+                free(spare[--i]);
+            }
+            return FAIL;
+        }
+    }
+    BPlusNode *node = leaf;
+    void *key = data;
+    BPlusNode *rightChild = NULL;
+    while (SUCCESS)
+    {
+        bplusInsertAt(node, idx, key, rightChild);
+        if (node->count <= BPLUS_MAX_KEYS)
+        {
+            break;
+        }
+        rightChild = spare[--spareCount];
+        bplusSplit(node, rightChild, &key);
+        if (depth == 0)
+        {
+            BPlusNode *root = spare[--spareCount];
+            root->keys[0] = key;
+            root->children[0] = node;
+            root->children[1] = rightChild;
+            root->count = 1;
+            pooled->bplusRoot = root;
+            break;
+        }
+        --depth;
+        node = path[depth];
+        idx = pathIdx[depth];
+    }
+    ++tree->size;
+    return SUCCESS;
+}
+
+/**
+ * looks an item up in a B+ tree
+ * @param tree the tree
+ * @param data the item
+ * @return the item of the tree which is equal to data, NULL if there is none
+ */
+void *bplusFind(RBTree *tree, void *data)
+{
+    BPlusNode *leaf = bplusFindLeaf(tree, data, NULL, NULL, NULL);
+    if (leaf == NULL)
+    {
+        return NULL;
+    }
+    int idx = bplusSearch(leaf, data, tree->compFunc, FAIL);
+    return idx < leaf->count && tree->compFunc(leaf->keys[idx], data) == EQUAL ? leaf->keys[idx] : NULL;
+}
+
+/**
+ * activate a function on the items of a B+ tree from low to high (both inclusive) by scanning the leaves
+ * @param tree the tree
+ * @param low the smallest item to visit, NULL for no lower bound
+ * @param high the largest item to visit, NULL for no upper bound
+ * @param func the function to activate
+ * @param args more optional arguments to the function
+ * @return 0 if one of the activations failed, other otherwise
+ */
+int bplusForEach(RBTree *tree, void *low, void *high, forEachFunc func, void *args)
+{
+    BPlusNode *leaf = ((PooledRBTree *) tree)->bplusRoot;
+    int idx = 0;
+    if (low == NULL)
+    {
+        while (leaf != NULL && !leaf->isLeaf)
+        {
+            leaf = leaf->children[0];
+        }
+    }
+    else
+    {
+        leaf = bplusFindLeaf(tree, low, NULL, NULL, NULL);
+        idx = leaf == NULL ? 0 : bplusSearch(leaf, low, tree->compFunc, FAIL);
+    }
+    for (; leaf != NULL; leaf = leaf->next, idx = 0)
+    {
+        for (; idx < leaf->count; ++idx)
+        {
+            if (high != NULL && tree->compFunc(leaf->keys[idx], high) > EQUAL)
+            {
+                return SUCCESS;
+            }
+            if (!func(leaf->keys[idx], args))
+            {
+                return FAIL;
+            }
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * counts the items of a B+ tree which are less than data, or not greater than it. the leaves before the one
+ * which may hold data are only summed up, not compared, so this is one descent plus a walk over the leaves.
+ * @param tree the tree
+ * @param data the item, it does not have to be in the tree
+ * @param inclusive 1 to count the item equal to data too
+ * @return the number of items
+ */
+size_t bplusCountBelow(RBTree *tree, void *data, int inclusive)
+{
+    BPlusNode *target = bplusFindLeaf(tree, data, NULL, NULL, NULL);
+    if (target == NULL)
+    {
+        return 0;
+    }
+    BPlusNode *leaf = ((PooledRBTree *) tree)->bplusRoot;
+    while (!leaf->isLeaf)
+    {
+        leaf = leaf->children[0];
+    }
+    size_t count = 0;
+    for (; leaf != target; leaf = leaf->next)
+    {
+        count += leaf->count;
+    }
+    return count + bplusSearch(target, data, tree->compFunc, inclusive);
+}
+
+/**
+ * frees a B+ tree level by level using the chain of every level, and the items kept in its leaves
+ * @param tree the tree
+ */
+void bplusFreeAll(RBTree *tree)
+{
+    BPlusNode *level = ((PooledRBTree *) tree)->bplusRoot;
+    while (level != NULL)
+    {
+        BPlusNode *below = level->isLeaf ? NULL : level->children[0];
+        BPlusNode *node = level;
+        while (node != NULL)
+        {
+            BPlusNode *next = node->next;
+            if (node->isLeaf)
+            {
+                for (int i = 0; i < node->count; ++i)
+                {
+                    tree->freeFunc(node->keys[i]);
+                }
+            }
+            free(node);
+            node = next;
+        }
+        level = below;
+    }
+    ((PooledRBTree *) tree)->bplusRoot = NULL;
+}
+
+/**
+ * rotates the tree nodes to the right as we saw in DAST
+ * @param node the node which we need to fix its position
+ */
+void rotateRight(Node *node)
+{
+    Node *left = node->left;
+    Node *parent = node->parent;
+    if (left->right != NULL)
+    {
+        left->right->parent = node;
+    }
+    node->left = left->right;
+    node->parent = left;
+    left->right = node;
+    left->parent = parent;
+    if (parent != NULL)
+    {
+        if (parent->right == node)
+        {
+            parent->right = left;
+        }
+        else
+        {
+            parent->left = left;
+        }
+    }
+}
+
+/**
+ * rotates the tree nodes to the left as we saw in DAST
+ * @param node the node which we need to fix its position
+ */
+void rotateLeft(Node *node)
+{
+    Node *right = node->right;
+    Node *parent = node->parent;
+    if (right->left != NULL)
+    {
+        right->left->parent = node;
+    }
+    node->right = right->left;
+    node->parent = right;
+    right->left = node;
+    right->parent = parent;
+
+    if (parent != NULL)
+    {
+        if (parent->left == node)
+        {
+            parent->left = right;
+        }
+        else
+        {
+            parent->right = right;
+        }
+    }
+}
+
+/**
+ * rotates to the left and updates the tree root and the subtree sizes
+ * @param tree the tree
+ * @param node the node which we need to fix its position
+ */
+void rotateLeftInTree(RBTree *tree, Node *node)
+{
+    rotateLeft(node);
+    if (hasSizes(tree))
+    {
+        updateSize(node);
+        updateSize(node->parent);
+    }
+    if (node->parent->parent == NULL)
+    {
+        tree->root = node->parent;
+    }
+}
+
+/**
+ * rotates to the right and updates the tree root and the subtree sizes
+ * @param tree the tree
+ * @param node the node which we need to fix its position
+ */
+void rotateRightInTree(RBTree *tree, Node *node)
+{
+    rotateRight(node);
+    if (hasSizes(tree))
+    {
+        updateSize(node);
+        updateSize(node->parent);
+    }
+    if (node->parent->parent == NULL)
+    {
+        tree->root = node->parent;
+    }
+}
+
+/**
+ * a getter
+ * @param node the node
+ * @return parent
+ */
+Node *getParent(Node *node)
+{
+    return node == NULL ? NULL : node->parent;
+}
+
+/**
+ * a getter
+ * @param node the node
+ * @return the grandparent
+ */
+Node *getGrandParent(Node *node)
+{
+    return getParent(getParent(node));
+}
+
+/**
+ * a getter
+ * @param node the node
+ * @return the node sibling
+ */
+Node *getSibling(Node *node)
+{
+    Node *parent = getParent(node);
+
+    if (parent == NULL)
+    {
+        return NULL;
+    }
+    if (node == parent->left)
+    {
+        return parent->right;
+    }
+    else
+    {
+        return parent->left;
+    }
+}
+
+/**
+ * a getter
+ * @param node the node
+ * @return the parent sibling
+ */
+Node *getUncle(Node *n)
+{
+    Node *p = getParent(n);
+    return getSibling(p);
+}
+
+/**
+ * case 4 second step defined by the pdf
+ * @param tree the tree
+ * @param node the node we added to the tree
+ */
+void caseFourSecondStep(RBTree *tree, Node *node)
+{
+    Node *grandP = getGrandParent(node);
+    Node *parent = node->parent;
+    parent->color = BLACK;
+    grandP->color = RED;
+    if (node == parent->left)
+    {
+        rotateRightInTree(tree, grandP);
+    }
+    else
+    {
+        rotateLeftInTree(tree, grandP);
+    }
+}// need to add it
+/**
+ * the 4 cases which we fix the tree accordingly, case 3 moves the problem two levels up so we loop instead of
+ * recursing
+ * @param tree the tree which need to be fixed
+ * @param node the node which we added
+ */
+void treeFix(RBTree *tree, Node *node)
+{
+    Node *parent = getParent(node);
+    while (parent != NULL && parent->color == RED)
+    {
+        Node *uncle = getUncle(node);
+        Node *grandP = getGrandParent(node);
+        if (uncle != NULL && uncle->color == RED)
+        {
+            uncle = unshareNode(tree, uncle);
+            parent->color = BLACK;
+            uncle->color = BLACK;
+            grandP->color = RED;
+            node = grandP;
+            parent = getParent(node);
+            continue;
+        }
+        if (node == parent->right && parent == grandP->left)
+        {
+            rotateLeftInTree(tree, parent);
+            node = node->left;
+        }
+        else if (node == parent->left && parent == grandP->right)
+        {
+            rotateRightInTree(tree, parent);
+            node = node->right;
+        }
+        caseFourSecondStep(tree, node);
+        return;
+    }
+    if (parent == NULL)
+    {
+        node->color = BLACK;
+    }
+}
+
+/**
+ * walks down the tree once, comparing once per level, and stops either on the node that holds equal data or on
+ * the node which the new data should hang from
+ * @param tree the tree
+ * @param data the data we want to insert
+ * @param lastComp the result of the last comparison, EQUAL if the data is already in the tree
+ * @return the last node we visited
+ */
+Node *findAttachPoint(RBTree *tree, void *data, int *lastComp)
+{
+    Node *cur = tree->root;
+    Node *parent = NULL;
+    int comp = EQUAL;
+    while (cur != NULL)
+    {
+        parent = cur;
+        comp = tree->compFunc(cur->data, data);
+        if (comp == EQUAL)
+        {
+            break;
+        }
+        cur = comp > EQUAL ? cur->left : cur->right;
+    }
+    *lastComp = comp;
+    return parent;
+}
+
+/**
+ * adds an item to a red black tree, between beginWrite and endWrite. only the path to the new node and the
+ * uncles which the fix recolours are unshared.
+ * @param tree the tree
+ * @param data the item
+ * @return 0 on failure, other on success
+ */
+int insertNode(RBTree *tree, void *data)
+{
+    int comp = EQUAL;
+    Node *parent = findAttachPoint(tree, data, &comp);
+    if (parent != NULL && comp == EQUAL)
+    {
+        return FAIL;
+    }
+    parent = unsharePath(tree, parent);
+    Node *node = newNode(getPool(tree), data);
+    if (node == NULL)
+    {
+        return FAIL;
+    }
+    ++tree->size;
+    if (parent == NULL) // case 1 new node is root
+    {
+        node->color = BLACK;
+        tree->root = node;
+        return SUCCESS;
+    }
+    node->parent = parent;
+    if (comp > EQUAL)
+    {
+        parent->left = node;
+    }
+    else
+    {
+        parent->right = node;
+    }
+    updateSizesUp(tree, parent);
+    treeFix(tree, node);
+    return SUCCESS;
+}
+
+/**
+ * the body of addToRBTree, called with the tree lock held
+ */
+int addToRBTreeUnlocked(RBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL)
+    {
+        return FAIL;
+    }
+    if (isBPlus(tree))
+    {
+        return bplusAdd(tree, data);
+    }
+    if (!beginWrite(tree))
+    {
+        return FAIL;
+    }
+    int ret = insertNode(tree, data);
+    endWrite(tree);
+    return ret;
+}
+
+/**
+ * add an item to the tree
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree (copied into the node for trees built with newInlineRBTree).
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int addToRBTree(RBTree *tree, void *data)
+{
+    if (tree == NULL)
+    {
+        return FAIL;
+    }
+    writeLockRBTree(tree);
+    int ret = addToRBTreeUnlocked(tree, data);
+    unlockRBTree(tree);
+    return ret;
+}
+
+/**
+ * a helper function which walks down the tree looking for the node
+ * @param root the tree root
+ * @param data the data which we looking for in the tree
+ * @param compFunc the compare function which we can check if the nodes hold the identical data
+ * @return the node which holds the data, NULL if not found
+ */
+Node *findNode(Node *root, void *data, CompareFunc compFunc)
+{
+    Node *cur = root;
+    while (cur != NULL)
+    {
+        int comp = compFunc(cur->data, data);
+        if (comp == EQUAL)
+        {
+            return cur;
+        }
+        cur = comp < EQUAL ? cur->right : cur->left;
+    }
+    return NULL;
+}
+
+/**
+ * looks an item up in the tree, called with the tree lock held
+ * @param tree the tree
+ * @param data the item
+ * @return the item of the tree which is equal to data, NULL if there is none
+ */
+void *findItemUnlocked(RBTree *tree, void *data)
+{
+    if (data == NULL)
+    {
+        return NULL;
+    }
+    if (isBPlus(tree))
+    {
+        return bplusFind(tree, data);
+    }
+    Node *node = findNode(tree->root, data, tree->compFunc);
+    return node == NULL ? NULL : node->data;
+}
+
+/**
+ * the body of containsRBTree, called with the tree lock held
+ */
+int containsRBTreeUnlocked(RBTree *tree, void *data)
+{
+    return findItemUnlocked(tree, data) != NULL ? SUCCESS : FAIL;
+}
+
+/**
+ * check whether the tree contains this item.
+ * @param tree: the tree to add an item to.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsRBTree(RBTree *tree, void *data)
+{
+    readLockRBTree(tree);
+    int ret = containsRBTreeUnlocked(tree, data);
+    unlockRBTree(tree);
+    return ret;
+}
+
+/**
+ * a getter
+ * @param node the root of a subtree
+ * @return the smallest node in the subtree
+ */
+Node *getMin(Node *node)
+{
+    while (node != NULL && node->left != NULL)
+    {
+        node = node->left;
+    }
+    return node;
+}
+
+/**
+ * a getter
+ * @param node the root of a subtree
+ * @return the largest node in the subtree
+ */
+Node *getMax(Node *node)
+{
+    while (node != NULL && node->right != NULL)
+    {
+        node = node->right;
+    }
+    return node;
+}
+
+/**
+ * a getter
+ * @param node a node in the tree
+ * @return the next node in ascending order, NULL if this is the last one
+ */
+Node *getSuccessor(Node *node)
+{
+    if (node->right != NULL)
+    {
+        return getMin(node->right);
+    }
+    Node *parent = node->parent;
+    while (parent != NULL && node == parent->right)
+    {
+        node = parent;
+        parent = parent->parent;
+    }
+    return parent;
+}
+
+/**
+ * a getter
+ * @param node a node in the tree
+ * @return the previous node in ascending order, NULL if this is the first one
+ */
+Node *getPredecessor(Node *node)
+{
+    if (node->left != NULL)
+    {
+        return getMax(node->left);
+    }
+    Node *parent = node->parent;
+    while (parent != NULL && node == parent->left)
+    {
+        node = parent;
+        parent = parent->parent;
+    }
+    return parent;
+}
+
+/**
+ * goes over a tree in ascending order without recursion. the nodes still to visit are kept on a stack as deep
+ * as the tree, which is cheaper than climbing back up the parent pointers and works on snapshots too, which
+ * can't use them (they belong to the tree the snapshot was taken from).
+ */
+typedef struct TreeWalk
+{
+    Node *cur;
+    int depth;
+    Node *pending[MAX_HEIGHT];
+} TreeWalk;
+
+/**
+ * starts a walk on the lower bound (or the upper bound) of an item
+ * @param tree the tree
+ * @param walk the walk, walk->cur is set to the first node, NULL if there is none
+ * @param low the item to start from, NULL to start from the smallest item
+ * @param strict if not 0 the walk starts after the items equal to low
+ */
+void startWalk(RBTree *tree, TreeWalk *walk, void *low, int strict)
+{
+    walk->cur = NULL;
+    walk->depth = 0;
+    Node *cur = tree->root;
+    while (cur != NULL)
+    {
+        int comp = low == NULL ? GREATER : tree->compFunc(cur->data, low);
+        if (comp < EQUAL || (comp == EQUAL && strict))
+        {
+            cur = cur->right;
+            continue;
+        }
+        walk->cur = cur;
+        walk->pending[walk->depth++] = cur;
+        cur = comp == EQUAL ? NULL : cur->left;
+    }
+}
+
+/**
+ * moves a walk to the next node in ascending order
+ * @param walk the walk
+ * @return the next node, NULL at the end
+ */
+Node *walkNext(TreeWalk *walk)
+{
+    if (walk->cur == NULL)
+    {
+        return NULL;
+    }
+    // the current node is on top of the stack, the nodes of its right subtree come before the rest
+    for (Node *cur = walk->pending[--walk->depth]->right; cur != NULL; cur = cur->left)
+    {
+        walk->pending[walk->depth++] = cur;
+    }
+    walk->cur = walk->depth == 0 ? NULL : walk->pending[walk->depth - 1];
+    return walk->cur;
+}
+
+/**
+ * rejects the functions which return cursors, a B+ tree has no nodes to point at and a cursor of a snapshot
+ * can't be moved since the snapshot does not own the parent pointers
+ * @param tree the tree
+ * @return 1 with errno set to ENOTSUP if the tree is a B+ tree or a snapshot, 0 otherwise
+ */
+int rejectCursors(RBTree *tree)
+{
+    if (rejectBPlus(tree))
+    {
+        return SUCCESS;
+    }
+    if (((PooledRBTree *) tree)->isSnapshot)
+    {
+        errno = ENOTSUP;
+        return SUCCESS;
+    }
+    return FAIL;
+}
+
+/**
+ * a cursor is a node of the tree, its item is cursor->data. a cursor stays valid while other items are added or
+ * removed, since nodes are relinked and never moved, unless the tree has open snapshots: a change then replaces
+ * the shared nodes it touches by copies.
+ * @param tree the tree
+ * @return a cursor to the smallest item, NULL if the tree is empty or is a B+ tree or a snapshot (errno is
+ * ENOTSUP then)
+ */
+Node *firstRBTree(RBTree *tree)
+{
+    return tree == NULL || rejectCursors(tree) ? NULL : getMin(tree->root);
+}
+
+/**
+ * a cursor to the end of the tree
+ * @param tree the tree
+ * @return a cursor to the largest item, NULL if the tree is empty or is a B+ tree or a snapshot (errno is
+ * ENOTSUP then)
+ */
+Node *lastRBTree(RBTree *tree)
+{
+    return tree == NULL || rejectCursors(tree) ? NULL : getMax(tree->root);
+}
+
+/**
+ * moves the cursor forward
+ * @param cursor a cursor to an item
+ * @return a cursor to the next item in ascending order, NULL at the end
+ */
+Node *nextRBTree(Node *cursor)
+{
+    return cursor == NULL ? NULL : getSuccessor(cursor);
+}
+
+/**
+ * moves the cursor backward
+ * @param cursor a cursor to an item
+ * @return a cursor to the previous item in ascending order, NULL at the beginning
+ */
+Node *prevRBTree(Node *cursor)
+{
+    return cursor == NULL ? NULL : getPredecessor(cursor);
+}
+
+/**
+ * seeks to the lower bound of data
+ * @param tree the tree
+ * @param data the item to seek to, it does not have to be in the tree
+ * @return a cursor to the smallest item which is not less than data, NULL if there is none or for a B+ tree
+ * or a snapshot (errno is ENOTSUP then)
+ */
+Node *lowerBoundRBTree(RBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL || rejectCursors(tree))
+    {
+        return NULL;
+    }
+    Node *cur = tree->root;
+    Node *bound = NULL;
+    while (cur != NULL)
+    {
+        int comp = tree->compFunc(cur->data, data);
+        if (comp == EQUAL)
+        {
+            return cur;
+        }
+        if (comp > EQUAL)
+        {
+            bound = cur;
+            cur = cur->left;
+        }
+        else
+        {
+            cur = cur->right;
+        }
+    }
+    return bound;
+}
+
+/**
+ * seeks to the upper bound of data
+ * @param tree the tree
+ * @param data the item to seek to, it does not have to be in the tree
+ * @return a cursor to the smallest item which is greater than data, NULL if there is none or for a B+ tree
+ * or a snapshot (errno is ENOTSUP then)
+ */
+Node *upperBoundRBTree(RBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL || rejectCursors(tree))
+    {
+        return NULL;
+    }
+    Node *cur = tree->root;
+    Node *bound = NULL;
+    while (cur != NULL)
+    {
+        if (tree->compFunc(cur->data, data) > EQUAL)
+        {
+            bound = cur;
+            cur = cur->left;
+        }
+        else
+        {
+            cur = cur->right;
+        }
+    }
+    return bound;
+}
+
+/**
+ * the body of forEachInRangeRBTree, called with the tree lock held
+ */
+int forEachInRangeRBTreeUnlocked(RBTree *tree, void *low, void *high, forEachFunc func, void *args)
+{
+    if (tree == NULL)
+    {
+        return FAIL;
+    }
+    if (isBPlus(tree))
+    {
+        return bplusForEach(tree, low, high, func, args);
+    }
+    TreeWalk walk;
+    startWalk(tree, &walk, low, FAIL);
+    for (Node *cur = walk.cur; cur != NULL && (high == NULL || tree->compFunc(cur->data, high) <= EQUAL);
+         cur = walkNext(&walk))
+    {
+        if (!func(cur->data, args))
+        {
+            return FAIL;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * Activate a function on each item between low and high (both inclusive) in ascending order. only the path to
+ * low and the items in range are visited. if one of the activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param low: the smallest item to visit, NULL for no lower bound.
+ * @param high: the largest item to visit, NULL for no upper bound.
+ * @param func: the function to activate on the items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachInRangeRBTree(RBTree *tree, void *low, void *high, forEachFunc func, void *args)
+{
+    if (tree == NULL)
+    {
+        return FAIL;
+    }
+    readLockRBTree(tree);
+    int ret = forEachInRangeRBTreeUnlocked(tree, low, high, func, args);
+    unlockRBTree(tree);
+    return ret;
+}
+
+/**
+ * counts the items which are less than data, in one descent if the tree keeps subtree sizes
+ * @param tree the tree
+ * @param data the item to compare with
+ * @param inclusive if not 0 items equal to data are counted as well
+ * @return the number of items
+ */
+size_t countBelow(RBTree *tree, void *data, int inclusive)
+{
+    size_t count = 0;
+    if (isBPlus(tree))
+    {
+        return bplusCountBelow(tree, data, inclusive);
+    }
+    if (!hasSizes(tree))
+    {
+        TreeWalk bound;
+        TreeWalk walk;
+        startWalk(tree, &bound, data, inclusive);
+        for (startWalk(tree, &walk, NULL, FAIL); walk.cur != bound.cur; walkNext(&walk))
+        {
+            ++count;
+        }
+        return count;
+    }
+    Node *cur = tree->root;
+    while (cur != NULL)
+    {
+        int comp = tree->compFunc(cur->data, data);
+        if (comp < EQUAL || (comp == EQUAL && inclusive))
+        {
+            count += getSize(cur->left) + 1;
+            cur = cur->right;
+        }
+        else
+        {
+            cur = cur->left;
+        }
+    }
+    return count;
+}
+
+/**
+ * the body of rankRBTree, called with the tree lock held
+ */
+size_t rankRBTreeUnlocked(RBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL)
+    {
+        return 0;
+    }
+    return countBelow(tree, data, FAIL);
+}
+
+/**
+ * the rank of an item, O(log n) for trees built with ORDER_STATISTICS, linear otherwise. a B+ tree counts its
+ * leaves up to the one that may hold the item, which is linear too but with few memory accesses.
+ * @param tree the tree
+ * @param data the item, it does not have to be in the tree
+ * @return the number of items in the tree which are less than data
+ */
+size_t rankRBTree(RBTree *tree, void *data)
+{
+    if (tree == NULL)
+    {
+        return 0;
+    }
+    readLockRBTree(tree);
+    size_t ret = rankRBTreeUnlocked(tree, data);
+    unlockRBTree(tree);
+    return ret;
+}
+
+/**
+ * the body of selectRBTree for red black trees, snapshots included when they keep subtree sizes
+ */
+Node *selectNode(RBTree *tree, size_t k)
+{
+    if (k >= tree->size)
+    {
+        return NULL;
+    }
+    Node *cur = tree->root;
+    if (!hasSizes(tree))
+    {
+        for (cur = getMin(cur); k > 0; --k)
+        {
+            cur = getSuccessor(cur);
+        }
+        return cur;
+    }
+    while (cur != NULL)
+    {
+        size_t leftSize = getSize(cur->left);
+        if (k == leftSize)
+        {
+            return cur;
+        }
+        if (k < leftSize)
+        {
+            cur = cur->left;
+        }
+        else
+        {
+            k -= leftSize + 1;
+            cur = cur->right;
+        }
+    }
+    return cur;
+}
+
+/**
+ * selects an item by its position, O(log n) for trees built with ORDER_STATISTICS and linear otherwise
+ * @param tree a red black tree
+ * @param k the 0 based position of the item in ascending order
+ * @return a cursor to the item, NULL if k is out of range or for a B+ tree or a snapshot (with errno set to
+ * ENOTSUP)
+ */
+Node *selectRBTree(RBTree *tree, size_t k)
+{
+    return tree == NULL || rejectCursors(tree) ? NULL : selectNode(tree, k);
+}
+
+/**
+ * ForEach function that counts the items it is activated on
+ * @param item the item
+ * @param count size_t* counter
+ * @return 1
+ */
+int countItem(const void *item, void *count)
+{
+    (void) item;
+    ++*(size_t *) count;
+    return SUCCESS;
+}
+
+/**
+ * the body of countInRangeRBTree, called with the tree lock held
+ */
+size_t countInRangeRBTreeUnlocked(RBTree *tree, void *low, void *high)
+{
+    size_t count = 0;
+    if (tree == NULL)
+    {
+        return count;
+    }
+    if (isBPlus(tree))
+    {
+        bplusForEach(tree, low, high, countItem, &count);
+        return count;
+    }
+    if (hasSizes(tree))
+    {
+        size_t below = low == NULL ? 0 : countBelow(tree, low, FAIL);
+        size_t upTo = high == NULL ? tree->size : countBelow(tree, high, SUCCESS);
+        return upTo > below ? upTo - below : 0;
+    }
+    forEachInRangeRBTreeUnlocked(tree, low, high, countItem, &count);
+    return count;
+}
+
+/**
+ * counts the items between low and high (both inclusive)
+ * @param tree the tree
+ * @param low the smallest item to count, NULL for no lower bound
+ * @param high the largest item to count, NULL for no upper bound
+ * @return the number of items in range
+ */
+size_t countInRangeRBTree(RBTree *tree, void *low, void *high)
+{
+    if (tree == NULL)
+    {
+        return 0;
+    }
+    readLockRBTree(tree);
+    size_t ret = countInRangeRBTreeUnlocked(tree, low, high);
+    unlockRBTree(tree);
+    return ret;
+}
+
+/**
+ * puts the subtree of replacement where the subtree of node was
+ * @param tree the tree
+ * @param node the node we take out
+ * @param replacement the node which takes its place, may be NULL
+ */
+void transplant(RBTree *tree, Node *node, Node *replacement)
+{
+    if (node->parent == NULL)
+    {
+        tree->root = replacement;
+    }
+    else if (node == node->parent->left)
+    {
+        node->parent->left = replacement;
+    }
+    else
+    {
+        node->parent->right = replacement;
+    }
+    if (replacement != NULL)
+    {
+        replacement->parent = node->parent;
+    }
+}
+
+/**
+ * a null node counts as black
+ * @param node the node
+ * @return 1 if the node is black
+ */
+int isBlack(Node *node)
+{
+    return node == NULL || node->color == BLACK;
+}
+
+/**
+ * the delete cases as we saw in DAST, node carries an extra black which we push up until it can be absorbed
+ * @param tree the tree which need to be fixed
+ * @param node the node which took the place of the removed one, may be NULL
+ * @param parent the parent of node (needed when node is NULL)
+ */
+void deleteFix(RBTree *tree, Node *node, Node *parent)
+{
+    node = unshareNode(tree, node);
+    while (node != tree->root && isBlack(node))
+    {
+        if (node == parent->left)
+        {
+            Node *sibling = unshareNode(tree, parent->right);
+            if (sibling->color == RED)
+            {
+                sibling->color = BLACK;
+                parent->color = RED;
+                rotateLeftInTree(tree, parent);
+                sibling = unshareNode(tree, parent->right);
+            }
+            if (isBlack(sibling->left) && isBlack(sibling->right))
+            {
+                sibling->color = RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (isBlack(sibling->right))
+            {
+                unshareNode(tree, sibling->left)->color = BLACK;
+                sibling->color = RED;
+                rotateRightInTree(tree, sibling);
+                sibling = parent->right;
+            }
+            sibling->color = parent->color;
+            parent->color = BLACK;
+            unshareNode(tree, sibling->right)->color = BLACK;
+            rotateLeftInTree(tree, parent);
         }
         else
         {
-            parent->left = left;
+            Node *sibling = unshareNode(tree, parent->left);
+            if (sibling->color == RED)
+            {
+                sibling->color = BLACK;
+                parent->color = RED;
+                rotateRightInTree(tree, parent);
+                sibling = unshareNode(tree, parent->left);
+            }
+            if (isBlack(sibling->left) && isBlack(sibling->right))
+            {
+                sibling->color = RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (isBlack(sibling->left))
+            {
+                unshareNode(tree, sibling->right)->color = BLACK;
+                sibling->color = RED;
+                rotateLeftInTree(tree, sibling);
+                sibling = parent->left;
+            }
+            sibling->color = parent->color;
+            parent->color = BLACK;
+            unshareNode(tree, sibling->left)->color = BLACK;
+            rotateRightInTree(tree, parent);
         }
+        node = tree->root;
+    }
+    if (node != NULL)
+    {
+        node->color = BLACK;
     }
 }
 
 /**
- * rotates the tree nodes to the left as we saw in DAST
- * @param node the node which we need to fix its position
+ * removes an item from a red black tree, between beginWrite and endWrite. the paths to the node and to its
+ * successor, and the siblings and nephews which the fix changes, are unshared.
+ * @param tree the tree
+ * @param data an item equal to the one to remove
+ * @return 0 on failure, other on success
  */
-void rotateLeft(Node *node)
+int removeNode(RBTree *tree, void *data)
 {
-    Node *right = node->right;
-    Node *parent = node->parent;
-    if (right->left != NULL)
+    Node *node = findNode(tree->root, data, tree->compFunc);
+    if (node == NULL)
     {
-        right->left->parent = node;
+        return FAIL;
     }
-    node->right = right->left;
-    node->parent = right;
-    right->left = node;
-    right->parent = parent;
-
-    if (parent != NULL)
+    node = unsharePath(tree, node);
+    Color removedColor = node->color;
+    Node *child = NULL;
+    Node *childParent = node->parent;
+    if (node->left == NULL)
     {
-        if (parent->left == node)
-        {
-            parent->left = right;
-        }
-        else
+        child = node->right;
+        transplant(tree, node, node->right);
+    }
+    else if (node->right == NULL)
+    {
+        child = node->left;
+        transplant(tree, node, node->left);
+    }
+    else
+    {
+        Node *next = unsharePath(tree, getMin(node->right));
+        removedColor = next->color;
+        child = next->right;
+        childParent = next;
+        if (next->parent != node)
         {
-            parent->right = right;
+            childParent = next->parent;
+            transplant(tree, next, next->right);
+            next->right = node->right;
+            next->right->parent = next;
         }
+        transplant(tree, node, next);
+        next->left = node->left;
+        next->left->parent = next;
+        next->color = node->color;
+    }
+    updateSizesUp(tree, childParent);
+    if (removedColor == BLACK)
+    {
+        deleteFix(tree, child, childParent);
     }
+    --tree->size;
+    retireData(tree, node->data);
+    releaseNode(getPool(tree), node);
+    return SUCCESS;
 }
 
 /**
- * a getter
- * @param node the node
- * @return parent
+ * the body of deleteFromRBTree, called with the tree lock held
  */
-Node *getParent(Node *node)
+int deleteFromRBTreeUnlocked(RBTree *tree, void *data)
 {
-    return node == NULL ? NULL : node->parent;
+    if (tree == NULL || data == NULL || !beginWrite(tree))
+    {
+        return FAIL;
+    }
+    int ret = removeNode(tree, data);
+    endWrite(tree);
+    return ret;
 }
 
 /**
- * a getter
- * @param node the node
- * @return the grandparent
+ * remove an item from the tree, the item is freed with the tree free function and its node goes back to the
+ * tree pool.
+ * @param tree: a red black tree to remove an item from.
+ * @param data: an item equal to the one to remove.
+ * @return: 0 on failure (if the item is not in the tree, or for a B+ tree with errno set to ENOTSUP), other on
+ * success.
  */
-Node *getGrandParent(Node *node)
+int deleteFromRBTree(RBTree *tree, void *data)
 {
-    return getParent(getParent(node));
+    if (tree == NULL || rejectBPlus(tree))
+    {
+        return FAIL;
+    }
+    writeLockRBTree(tree);
+    int ret = deleteFromRBTreeUnlocked(tree, data);
+    unlockRBTree(tree);
+    return ret;
 }
 
 /**
- * a getter
- * @param node the node
- * @return the node sibling
+ * the body of forEachRBTree, called with the tree lock held
  */
-Node *getSibling(Node *node)
+int forEachRBTreeUnlocked(RBTree *tree, forEachFunc func, void *args)
 {
-    Node *parent = getParent(node);
-
-    if (parent == NULL)
-    {
-        return NULL;
-    }
-    if (node == parent->left)
+    int ret = FAIL;
+    if (tree != NULL)
     {
-        return parent->right;
+        ret = forEachInRangeRBTreeUnlocked(tree, NULL, NULL, func, args);
     }
-    else
+    return ret;
+}
+
+/**
+ * Activate a function on each item of the tree. the order is an ascending order. if one of the activations of the
+ * function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachRBTree(RBTree *tree, forEachFunc func, void *args)
+{
+    if (tree == NULL)
     {
-        return parent->left;
+        return FAIL;
     }
+    readLockRBTree(tree);
+    int ret = forEachRBTreeUnlocked(tree, func, args);
+    unlockRBTree(tree);
+    return ret;
 }
 
 /**
- * a getter
- * @param node the node
- * @return the parent sibling
+ * a unit of work for a worker thread
  */
-Node *getUncle(Node *n)
+typedef struct Task
 {
-    Node *p = getParent(n);
-    return getSibling(p);
-}
+    void **items;
+    void **buffer;
+    size_t lo;
+    size_t mid;
+    size_t hi;
+    CompareFunc compFunc;
+    RBTree *tree;
+    Node *first;
+    Node *end;
+    forEachFunc func;
+    void *args;
+    int isOk;
+} Task;
 
 /**
- * case 4 second step defined by the pdf
- * @param tree the tree
- * @param node the node we added to the tree
+ * runs every task on its own thread and waits for all of them. a task whose thread can't be created runs on
+ * the calling thread instead.
+ * @param work the function which does a task
+ * @param tasks the tasks
+ * @param count the number of tasks
  */
-void caseFourSecondStep(RBTree *tree, Node *node)
+void runTasks(void *(*work)(void *), Task *tasks, int count)
 {
-    Node *grandP = getGrandParent(node);
-    Node *parent = node->parent;
-    parent->color = BLACK;
-    grandP->color = RED;
-    if (node == parent->left)
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS];
+    for (int i = 0; i < count; ++i)
     {
-        rotateRight(grandP);
-        if (getGrandParent(node) == NULL)
+        started[i] = pthread_create(&threads[i], NULL, work, &tasks[i]) == 0;
+        if (!started[i])
         {
-            tree->root = node->parent;
+            work(&tasks[i]);
         }
     }
-    else
+    for (int i = 0; i < count; ++i)
     {
-        rotateLeft(grandP);
-        if (getGrandParent(node) == NULL)
+        if (started[i])
         {
-            tree->root = node->parent;
+            pthread_join(threads[i], NULL);
         }
     }
-}// need to add it
+}
+
 /**
- * the 4 cases which we fix the tree accordingly
- * @param tree the tree which need to be fixed
- * @param node the node which we added
+ * sorts the items of a task between lo and hi
+ * @param arg the task
+ * @return NULL
  */
-void treeFix(RBTree *tree, Node *node)
+void *sortTask(void *arg)
 {
-    Node *uncle = getUncle(node);
-    Node *parent = getParent(node);
-    Node *grandP = getGrandParent(node);
-    if (parent == NULL)
+    Task *task = (Task *) arg;
+    task->isOk = sortItems(task->items + task->lo, task->hi - task->lo, task->compFunc);
+    return NULL;
+}
+
+/**
+ * merges the two runs of a task from its items into its buffer
+ * @param arg the task
+ * @return NULL
+ */
+void *mergeTask(void *arg)
+{
+    Task *task = (Task *) arg;
+    mergeRuns(task->items, task->buffer, task->lo, task->mid, task->hi, task->compFunc);
+    return NULL;
+}
+
+/**
+ * stable sort which sorts a chunk of the items on every thread and then merges the chunks in pairs, the merges
+ * of a round running in parallel
+ * @param items the items to sort
+ * @param count the number of items
+ * @param compFunc the compare function
+ * @param threads the number of threads to use
+ * @return 0 on allocation failure, other on success
+ */
+int parallelSortItems(void **items, size_t count, CompareFunc compFunc, int threads)
+{
+    if (threads < 1 || (size_t) threads > count)
     {
-        node->color = BLACK;
+        threads = 1;
     }
-    else if (parent->color == BLACK)
+    threads = threads > MAX_THREADS ? MAX_THREADS : threads;
+    if (threads == 1)
     {
-        return;
+        return sortItems(items, count, compFunc);
     }
-    else if (uncle != NULL && uncle->color == RED)
+    size_t bounds[MAX_THREADS + 1];
+    Task tasks[MAX_THREADS];
+    for (int i = 0; i <= threads; ++i)
     {
-        parent->color = BLACK;
-        uncle->color = BLACK;
-        grandP->color = RED;
-        treeFix(tree, grandP);
+        bounds[i] = count * i / threads;
     }
-    else
+    int isOk = SUCCESS;
+    for (int i = 0; i < threads; ++i)
     {
-        if (node == parent->right && parent == grandP->left)
+        tasks[i].items = items;
+        tasks[i].lo = bounds[i];
+        tasks[i].hi = bounds[i + 1];
+        tasks[i].compFunc = compFunc;
+    }
+    runTasks(sortTask, tasks, threads);
+    for (int i = 0; i < threads; ++i)
+    {
+        isOk = isOk && tasks[i].isOk;
+    }
+    void **buffer = isOk ? (void **) malloc(count * sizeof(void *)) : NULL;
+    if (buffer == NULL)
+    {
+        return FAIL;
+    }
+    void **from = items;
+    void **to = buffer;
+    for (int runs = threads; runs > 1; runs = (runs + 1) / 2)
+    {
+        int pairs = 0;
+        for (int i = 0; i + 1 < runs; i += 2, ++pairs)
         {
-            rotateLeft(parent);
-            if (getGrandParent(node) == NULL)
-            {
-                tree->root = node->parent;
-            }
-            node = node->left;
+            tasks[pairs].items = from;
+            tasks[pairs].buffer = to;
+            tasks[pairs].lo = bounds[i];
+            tasks[pairs].mid = bounds[i + 1];
+            tasks[pairs].hi = bounds[i + 2];
+            tasks[pairs].compFunc = compFunc;
         }
-        else if (node == parent->left && parent == grandP->right)
+        runTasks(mergeTask, tasks, pairs);
+        if (runs % 2 == 1)
         {
-            rotateRight(parent);
-            if (getGrandParent(node) == NULL)
-            {
-                tree->root = node->parent;
-            }
-            node = node->right;
+            memcpy(to + bounds[runs - 1], from + bounds[runs - 1], (count - bounds[runs - 1]) * sizeof(void *));
         }
-        caseFourSecondStep(tree, node);
+        for (int i = 0; 2 * i <= runs; ++i)
+        {
+            bounds[i] = bounds[2 * i < runs ? 2 * i : runs];
+        }
+        bounds[(runs + 1) / 2] = count;
+        void **tmp = from;
+        from = to;
+        to = tmp;
     }
+    if (from != items)
+    {
+        memcpy(items, from, count * sizeof(void *));
+    }
+    free(buffer);
+    return SUCCESS;
 }
 
 /**
- * inserting a node to the first null place its finds recurse
- * @param cur current node
- * @param node the node we want to insert into the tree
- * @param compareFunc the tree comp func
+ * merges sorted items into the tree. a tree that is small next to the batch is rebuilt in linear time from its
+ * own items and the batch, otherwise the items are added one by one. an item which is the very pointer the tree
+ * (or an earlier equal item of the batch) already holds is not rejected, so it can't be freed from under it.
+ * @param tree the tree, locked for writing
+ * @param items ascending items, equal items may repeat
+ * @param count the number of items
+ * @param rejected filled with the items which were already in the tree or repeated in the batch
+ * @param rejectedCount set to the number of rejected items
+ * @return the number of items the tree did not take, they are moved to the front of items. 0 on success.
  */
-void regularBSTInsert(RBTree *tree, Node *cur, Node *node, CompareFunc compareFunc)
+size_t mergeSortedIntoTree(RBTree *tree, void **items, size_t count, void **rejected, size_t *rejectedCount)
 {
-    if (cur != NULL && cur->data != NULL)
+    if (((PooledRBTree *) tree)->isSnapshot)
+    {
+        return count;
+    }
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < count; ++i)
     {
-        if (compareFunc(cur->data, node->data) > EQUAL)
+        if (uniqueCount == 0 || tree->compFunc(items[uniqueCount - 1], items[i]) != EQUAL)
         {
-            if (cur->left == NULL)
-            {
-                cur->left = node;
-            }
-            else
-            {
-                regularBSTInsert(tree, cur->left, node, compareFunc);
-                return;
-            }
+            items[uniqueCount++] = items[i];
         }
-        else
+        else if (items[uniqueCount - 1] != items[i])
+        {
+            rejected[(*rejectedCount)++] = items[i];
+        }
+    }
+    if (isBPlus(tree) || tree->size > uniqueCount || hasOpenSnapshots(tree))
+    {
+        for (size_t i = 0; i < uniqueCount; ++i)
         {
-            if (cur->right == NULL)
+            if (addToRBTreeUnlocked(tree, items[i]))
+            {
+                continue;
+            }
+            void *held = findItemUnlocked(tree, items[i]);
+            if (held == NULL)
             {
-                cur->right = node;
+                memmove(items, items + i, (uniqueCount - i) * sizeof(void *));
+                return uniqueCount - i;
             }
-            else
+            if (held != items[i])
             {
-                regularBSTInsert(tree, cur->right, node, compareFunc);
-                return;
+                rejected[(*rejectedCount)++] = items[i];
             }
         }
-        node->parent = cur;
-        node->color = RED;
-        ++tree->size;
+        return 0;
     }
-}
-
-/**
- * add an item to the tree
- * @param tree: the tree to add an item to.
- * @param data: item to add to the tree.
- * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
- */
-int addToRBTree(RBTree *tree, void *data)
-{
-    if (tree == NULL || data == NULL)
+    void **all = (void **) malloc((tree->size + uniqueCount + 1) * sizeof(void *));
+    if (all == NULL)
     {
-        return FAIL;
+        return uniqueCount;
     }
-    else
+    size_t allCount = 0, i = 0, added = 0;
+    Node *cur = getMin(tree->root);
+    while (cur != NULL || i < uniqueCount)
     {
-        Node *node = newNode(data);
-        if (tree->root == NULL) // case 1 new node is root
+        int comp = cur == NULL ? GREATER : i == uniqueCount ? LESS : tree->compFunc(cur->data, items[i]);
+        if (comp == EQUAL)
         {
-            node->color = BLACK;
-            tree->root = node;
-            ++tree->size;
-            return SUCCESS;
+            if (cur->data != items[i])
+            {
+                rejected[(*rejectedCount)++] = items[i];
+            }
+            ++i;
         }
-        else if (containsRBTree(tree, data) == SUCCESS)
+        if (comp <= EQUAL)
         {
-            free(node);
-            return FAIL;
+            all[allCount++] = cur->data;
+            cur = getSuccessor(cur);
         }
         else
         {
-            regularBSTInsert(tree, tree->root, node, tree->compFunc);
-            treeFix(tree, node);
-            return SUCCESS;
+            items[added++] = items[i];
+            all[allCount++] = items[i++];
         }
     }
+    int isOk = buildFromSorted(tree, all, allCount);
+    free(all);
+    return isOk ? 0 : added;
 }
 
 /**
- * a helper function which search inorder for the node
- * @param root the current node
- * @param data the data which we looking for in the tree
- * @param compFunc the compare function which we can check if the nodes hold the identical data
- * @return 1 if found 0 if not
+ * add many items to the tree at once. the items are sorted on several threads, then the tree lock is taken
+ * once for the whole batch. the ownership rule: when the call returns n, the caller still owns items[0..n) and
+ * nothing else of the batch. the other items are owned by the tree, or were freed with the tree free function
+ * because they are equal to an item already in the tree or earlier in the batch, just like addToRBTree rejects
+ * them. a pointer the tree already holds is never freed. a tree which keeps its items inline copies them, and
+ * frees none. a batch larger than the tree rebuilds the tree, which invalidates its cursors.
+ * @param tree the tree to add the items to
+ * @param items the items, none of them NULL. the array is reordered.
+ * @param count the number of items
+ * @param threads the number of threads to sort with
+ * @return the number of items left to the caller at the front of items, 0 on success
  */
-int recursiveContains(Node *root, void *data, CompareFunc compFunc)
+size_t addBatchToRBTree(RBTree *tree, void **items, size_t count, int threads)
 {
-    if (root == NULL)
+    if (tree == NULL || items == NULL)
     {
-        return FAIL;
+        return count;
     }
-    else
+    for (size_t i = 0; i < count; ++i)
     {
-        if (compFunc(root->data, data) == EQUAL)
-        {
-            return SUCCESS;
-        }
-        else if (compFunc(root->data, data) < EQUAL)
+        if (items[i] == NULL)
         {
-            return recursiveContains(root->right, data, compFunc);
+            return count;
         }
-        return recursiveContains(root->left, data, compFunc);
     }
+    void **rejected = (void **) malloc((count + 1) * sizeof(void *));
+    if (rejected == NULL || !parallelSortItems(items, count, tree->compFunc, threads))
+    {
+        free(rejected);
+        return count;
+    }
+    size_t rejectedCount = 0;
+    writeLockRBTree(tree);
+    size_t left = mergeSortedIntoTree(tree, items, count, rejected, &rejectedCount);
+    unlockRBTree(tree);
+    if (getPool(tree)->keySize == 0)
+    {
+        freeDistinct(rejected, rejectedCount, tree->freeFunc);
+    }
+    free(rejected);
+    return left;
 }
 
 /**
- * check whether the tree contains this item.
- * @param tree: the tree to add an item to.
- * @param data: item to check.
- * @return: 0 if the item is not in the tree, other if it is.
+ * activates the function of a task on the items from first up to end (not included)
+ * @param arg the task
+ * @return NULL
  */
-int containsRBTree(RBTree *tree, void *data)
+void *forEachTask(void *arg)
 {
-    if (tree->root == NULL || data == NULL)
+    Task *task = (Task *) arg;
+    task->isOk = SUCCESS;
+    if (task->first == NULL)
     {
-        return FAIL;
+        return NULL;
     }
-    return recursiveContains(tree->root, data, tree->compFunc) ? SUCCESS : FAIL;
+    TreeWalk walk;
+    startWalk(task->tree, &walk, task->first->data, FAIL);
+    for (Node *cur = walk.cur; cur != task->end && task->isOk; cur = walkNext(&walk))
+    {
+        task->isOk = task->func(cur->data, task->args);
+    }
+    return NULL;
 }
 
-int inOrder(Node *root, forEachFunc func, void *args)
+/**
+ * splits the tree into contiguous chunks of roughly the same size, using select when the tree keeps subtree
+ * sizes and the subtrees of the first level which is wide enough otherwise
+ * @param tree the tree
+ * @param starts filled with the first node of every chunk, the last entry is the end (NULL)
+ * @param chunks the number of chunks
+ */
+void splitTree(RBTree *tree, Node **starts, int chunks)
 {
-    int isOk = SUCCESS;
-    if (root != NULL)
+    if (hasSizes(tree))
     {
-        if (root->left != NULL)
-        {
-            isOk = inOrder(root->left, func, args);
-            if (!isOk)
-            {
-                return isOk;
-            }
-        }
-        isOk = func(root->data, args);
-        if (!isOk)
+        for (int i = 0; i <= chunks; ++i)
         {
-            return isOk;
+            starts[i] = selectNode(tree, tree->size * i / chunks);
         }
-        if (root->right != NULL)
+        return;
+    }
+    Node *level[2 * MAX_THREADS];
+    Node *below[2 * MAX_THREADS];
+    int width = 0;
+    if (tree->root != NULL)
+    {
+        level[width++] = tree->root;
+    }
+    while (width > 0 && width < chunks)
+    {
+        int belowWidth = 0;
+        for (int i = 0; i < width; ++i)
         {
-            isOk = inOrder(root->right, func, args);
-            if (!isOk)
+            if (level[i]->left != NULL)
+            {
+                below[belowWidth++] = level[i]->left;
+            }
+            if (level[i]->right != NULL)
             {
-                return isOk;
+                below[belowWidth++] = level[i]->right;
             }
         }
+        if (belowWidth <= width)
+        {
+            break;
+        }
+        width = belowWidth;
+        memcpy(level, below, width * sizeof(Node *));
     }
-    return isOk;
+    for (int i = 0; i < chunks; ++i)
+    {
+        starts[i] = (width == 0 || i * width / chunks == 0) ? getMin(tree->root) : getMin(level[i * width / chunks]);
+    }
+    starts[chunks] = NULL;
 }
 
 /**
- * Activate a function on each item of the tree. the order is an ascending order. if one of the activations of the
- * function returns 0, the process stops.
+ * Activate a function on the items of the tree on several threads, for reductions which can be computed per
+ * chunk and combined. the tree is split into contiguous chunks in ascending order, thread i goes over chunk i in
+ * ascending order with args[i], so the caller combines args[0], args[1], ... in that order. a chunk stops when
+ * one of its activations returns 0. B+ trees are not split, all their items go to args[0].
  * @param tree: the tree with all the items.
- * @param func: the function to activate on all items.
- * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @param func: the function to activate on all items, it must not change the tree.
+ * @param args: one argument per thread.
+ * @param threads: the number of threads (and of entries in args).
  * @return: 0 on failure, other on success.
  */
-int forEachRBTree(RBTree *tree, forEachFunc func, void *args)
+int forEachRBTreeParallel(RBTree *tree, forEachFunc func, void **args, int threads)
 {
-    int ret = FAIL;
-    if (tree != NULL)
+    if (tree == NULL || args == NULL || threads < 1 || threads > MAX_THREADS)
     {
-        ret = inOrder(tree->root, func, args);
+        return FAIL;
     }
-    return ret;
+    readLockRBTree(tree);
+    if (isBPlus(tree))
+    {
+        int ret = forEachRBTreeUnlocked(tree, func, args[0]);
+        unlockRBTree(tree);
+        return ret;
+    }
+    Node *starts[MAX_THREADS + 1];
+    Task tasks[MAX_THREADS];
+    splitTree(tree, starts, threads);
+    for (int i = 0; i < threads; ++i)
+    {
+        tasks[i].tree = tree;
+        tasks[i].first = starts[i];
+        tasks[i].end = starts[i + 1];
+        tasks[i].func = func;
+        tasks[i].args = args[i];
+    }
+    runTasks(forEachTask, tasks, threads);
+    unlockRBTree(tree);
+    int isOk = SUCCESS;
+    for (int i = 0; i < threads; ++i)
+    {
+        isOk = isOk && tasks[i].isOk;
+    }
+    return isOk;
 }
 
 /**
- * helper function which traverse thru the tree and free all the nodes
- * @param root the current node
+ * helper function which goes over the slabs of the tree, frees the data of every node that is in use and then
+ * releases the slabs themselves
+ * @param pool the tree pool
  * @param freeFunc the tree free function
  */
-void freeAll(Node *root, FreeFunc freeFunc)
+void freeAll(NodePool *pool, FreeFunc freeFunc)
 {
-    if (root == NULL)
+    if (pool->keySize != 0)
     {
+        releaseSlabs(pool);
         return;
     }
-    freeAll(root->left, freeFunc);
-    freeAll(root->right, freeFunc);
-    freeFunc(root->data);
-    free(root);
+    for (Slab *slab = pool->slabs; slab != NULL; slab = slab->next)
+    {
+        for (size_t i = 0; i < slab->used; ++i)
+        {
+            Node *node = getSlabNode(pool, slab, i);
+            if (node->data != NULL)
+            {
+                freeFunc(node->data);
+            }
+        }
+    }
+    releaseSlabs(pool);
 }
 
 /**
@@ -440,6 +3022,43 @@ void freeAll(Node *root, FreeFunc freeFunc)
  */
 void freeRBTree(RBTree *tree)
 {
-    freeAll(tree->root, tree->freeFunc);
-    free(tree);
+    PooledRBTree *pooled = (PooledRBTree *) tree;
+    if (pooled->isSnapshot)
+    {
+        freeSnapshot(pooled);
+        return;
+    }
+    bplusFreeAll(tree);
+    SnapshotGroup *group = pooled->group;
+    int isGroupDone = SUCCESS;
+    if (group != NULL)
+    {
+        pthread_mutex_lock(&group->mutex);
+        if (group->openSnapshots > 0)
+        {
+            // the snapshots may still see our items and nodes, so the items are retired and the slabs are kept
+            for (Node *cur = getMin(tree->root); cur != NULL; cur = getSuccessor(cur))
+            {
+                retireData(tree, cur->data);
+            }
+            group->pool = pooled->pool;
+            group->liveFreed = SUCCESS;
+            isGroupDone = FAIL;
+        }
+        pthread_mutex_unlock(&group->mutex);
+    }
+    if (isGroupDone)
+    {
+        freeAll(getPool(tree), tree->freeFunc);
+        if (group != NULL)
+        {
+            pthread_mutex_destroy(&group->mutex);
+            free(group);
+        }
+    }
+    if (pooled->isThreadSafe)
+    {
+        pthread_rwlock_destroy(&pooled->lock);
+    }
+    free(pooled);
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+/**
+ * @file RBTreeExt.h
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 12 Dec 2019
+ *
+ * @brief The RBTree functions beyond the ones declared by RBTree.h
+ *
+ * @section DESCRIPTION
+ * RBTree.h is given by the exercise and can't change, so the rest of the public functions of RBTree.c and their
+ * flags are declared here. The doc comments in RBTree.c have the details.
+ */
+#ifndef RBTREE_EXT_H
+#define RBTREE_EXT_H
+
+#include <stddef.h>
+#include "RBTree.h"
+
+/**
+ * a flag of newRBTreeWithPool and newInlineRBTree, keeps subtree sizes so rank and select take O(log n)
+ */
+#define ORDER_STATISTICS 1
+
+/**
+ * a flag of newRBTreeWithPool and newInlineRBTree, guards the tree with a reader writer lock
+ */
+#define THREAD_SAFE 2
+
+/**
+ * a flag of newRBTreeWithPool and newInlineRBTree, keeps a reference count per node so snapshotRBTree can share
+ * the nodes of the tree
+ */
+#define SNAPSHOTS 4
+
+/**
+ * constructs a new RBTree whose nodes are taken from slabs of slabNodes nodes (0 for the default)
+ * @return the new tree, NULL on failure
+ */
+RBTree *newRBTreeWithPool(CompareFunc compFunc, FreeFunc freeFunc, size_t slabNodes, int flags);
+
+/**
+ * constructs a new RBTree from strictly ascending items in linear time, the tree owns the items on success
+ * @return the new tree, NULL on failure or if the items are not strictly ascending
+ */
+RBTree *newRBTreeFromSorted(CompareFunc compFunc, FreeFunc freeFunc, void **items, size_t count);
+
+/**
+ * constructs a new RBTree from items in any order, the items which are equal to an earlier one are freed
+ * @return the new tree, NULL on failure (nothing is freed in that case)
+ */
+RBTree *newRBTreeFromArray(CompareFunc compFunc, FreeFunc freeFunc, void **items, size_t count);
+
+/**
+ * removes an item from a red black tree and frees it with the tree free function
+ * @return 0 if the item is not in the tree or for a B+ tree (errno is ENOTSUP then), other on success
+ */
+int deleteFromRBTree(RBTree *tree, void *data);
+
+/**
+ * the cursor functions need red black nodes which own their parent pointers, on a B+ tree or a snapshot they
+ * return NULL and set errno to ENOTSUP
+ * @return a cursor to the smallest item, NULL if the tree is empty. its item is cursor->data.
+ */
+Node *firstRBTree(RBTree *tree);
+
+/**
+ * @return a cursor to the largest item, NULL if the tree is empty
+ */
+Node *lastRBTree(RBTree *tree);
+
+/**
+ * @return a cursor to the next item in ascending order, NULL at the end
+ */
+Node *nextRBTree(Node *cursor);
+
+/**
+ * @return a cursor to the previous item in ascending order, NULL at the beginning
+ */
+Node *prevRBTree(Node *cursor);
+
+/**
+ * @return a cursor to the smallest item which is not less than data, NULL if there is none
+ */
+Node *lowerBoundRBTree(RBTree *tree, void *data);
+
+/**
+ * @return a cursor to the smallest item which is greater than data, NULL if there is none
+ */
+Node *upperBoundRBTree(RBTree *tree, void *data);
+
+/**
+ * activates func on each item between low and high (both inclusive, NULL for no bound) in ascending order
+ * @return 0 if one of the activations failed, other otherwise
+ */
+int forEachInRangeRBTree(RBTree *tree, void *low, void *high, forEachFunc func, void *args);
+
+/**
+ * @return the number of items between low and high (both inclusive, NULL for no bound)
+ */
+size_t countInRangeRBTree(RBTree *tree, void *low, void *high);
+
+/**
+ * @return the number of items in the tree which are less than data
+ */
+size_t rankRBTree(RBTree *tree, void *data);
+
+/**
+ * @return a cursor to the item at position k in ascending order (from 0), NULL if k is out of range or for a B+
+ * tree or a snapshot (errno is ENOTSUP then)
+ */
+Node *selectRBTree(RBTree *tree, size_t k);
+
+/**
+ * constructs a new RBTree which copies each item of keySize bytes into its node
+ * @return the new tree, NULL on failure
+ */
+RBTree *newInlineRBTree(CompareFunc compFunc, size_t keySize, int flags);
+
+/**
+ * constructs a new tree which keeps its items in a B+ tree instead of a red black tree. cursors, select, delete
+ * and snapshots are only available for red black trees.
+ * @return the new tree, NULL on failure
+ */
+RBTree *newBPlusRBTree(CompareFunc compFunc, FreeFunc freeFunc);
+
+/**
+ * @return 1 if the tree uses the B+ tree engine
+ */
+int isBPlus(RBTree *tree);
+
+/**
+ * takes the lock of a THREAD_SAFE tree for reading, does nothing for other trees
+ */
+void readLockRBTree(RBTree *tree);
+
+/**
+ * takes the lock of a THREAD_SAFE tree for writing, does nothing for other trees
+ */
+void writeLockRBTree(RBTree *tree);
+
+/**
+ * releases the tree lock
+ */
+void unlockRBTree(RBTree *tree);
+
+/**
+ * adds many items to the tree at once, sorting them on several threads
+ * @return the number of items the tree did not take, moved to the front of items. 0 on success.
+ */
+size_t addBatchToRBTree(RBTree *tree, void **items, size_t count, int threads);
+
+/**
+ * activates func on contiguous chunks of the tree on several threads, thread i with args[i]
+ * @return 0 if one of the activations failed, other otherwise
+ */
+int forEachRBTreeParallel(RBTree *tree, forEachFunc func, void **args, int threads);
+
+/**
+ * takes a read only snapshot of a red black tree built with SNAPSHOTS in O(1), freed with freeRBTree. while it is
+ * open every change to the tree copies the O(log n) nodes it touches instead of changing them.
+ * @return the snapshot, NULL on failure or for a B+ tree or a tree built without SNAPSHOTS (errno is ENOTSUP then)
+ */
+RBTree *snapshotRBTree(RBTree *tree);
+
+#endif //RBTREE_EXT_H
@@ -12,9 +12,23 @@
  * Process: checks if the user input is valid, and then define a node
  * Output : a valid node
  */
+#define _GNU_SOURCE
+#include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <malloc.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "Structs.h"
+#include "StructsExt.h"
+#include "RBTreeExt.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define X86_KERNELS
+#endif
 
 #define LESS (-1)
 #define EQUAL (0)
@@ -24,6 +38,14 @@
 #define FAIL (0)
 #define SQUARE(a) (a)*(a)
 #define UNDEFINED_SIZE (-1)
+#define MAX_THREADS 64
+#define DEFAULT_ARENA_VECTORS 1024
+#define DEFAULT_ARENA_VALUES 65536
+#define PREFIX_BYTES 8
+#define MIN_JOIN_CAPACITY 64
+#define FILE_MAGIC "RBT1"
+#define STRING_ITEMS 1
+#define VECTOR_ITEMS 2
 
 /**
  * CompFunc for strings (assumes strings end with "\0")
@@ -64,6 +86,252 @@ int concatenate(const void *word, void *pConcatenated)
 
 }
 
+/**
+ * @param a first array
+ * @param b second array
+ * @param len the arrays length
+ * @return the first index in which the arrays differ, len if they are equal
+ */
+int firstMismatchScalar(const double *a, const double *b, int len)
+{
+    int i = 0;
+    while (i < len && a[i] == b[i])
+    {
+        ++i;
+    }
+    return i;
+}
+
+#ifdef X86_KERNELS
+
+/**
+ * firstMismatchScalar with SSE2, two lanes compared at a time
+ */
+__attribute__((target("sse2"))) int firstMismatchSse2(const double *a, const double *b, int len)
+{
+    int i = 0;
+    for (; i + 2 <= len; i += 2)
+    {
+        int mask = _mm_movemask_pd(_mm_cmpneq_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + firstMismatchScalar(a + i, b + i, len - i);
+}
+
+/**
+ * firstMismatchScalar with AVX2, four lanes compared at a time
+ */
+__attribute__((target("avx2"))) int firstMismatchAvx2(const double *a, const double *b, int len)
+{
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        __m256d neq = _mm256_cmp_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), _CMP_NEQ_UQ);
+        int mask = _mm256_movemask_pd(neq);
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + firstMismatchScalar(a + i, b + i, len - i);
+}
+
+#endif
+
+/**
+ * firstMismatchScalar using the widest vector instructions the cpu supports
+ */
+int firstMismatch(const double *a, const double *b, int len)
+{
+#ifdef X86_KERNELS
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return firstMismatchAvx2(a, b, len);
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return firstMismatchSse2(a, b, len);
+    }
+#endif
+    return firstMismatchScalar(a, b, len);
+}
+
+/**
+ * the header placed right before the chars of a string key: its length and its first PREFIX_BYTES bytes packed
+ * big endian (zero padded), so comparing prefixes as numbers orders them like strcmp
+ */
+typedef struct StringKeyHeader
+{
+    size_t len;
+    uint64_t prefix;
+} StringKeyHeader;
+
+/**
+ * @param s a string key
+ * @return the header of the key
+ */
+StringKeyHeader *getStringKeyHeader(const char *s)
+{
+    return (StringKeyHeader *) (s - sizeof(StringKeyHeader));
+}
+
+/**
+ * copies a string into a new string key. the key is an ordinary C string, so it can be used wherever a char* is,
+ * but it must be freed with freeStringKey.
+ * @param s the string to copy
+ * @return the new key, NULL on failure
+ */
+char *newStringKey(const char *s)
+{
+    if (s == NULL)
+    {
+        return NULL;
+    }
+    size_t len = strlen(s);
+    StringKeyHeader *header = (StringKeyHeader *) malloc(sizeof(StringKeyHeader) + len + 1);
+    if (header == NULL)
+    {
+        return NULL;
+    }
+    char *key = (char *) (header + 1);
+    memcpy(key, s, len + 1);
+    header->len = len;
+    header->prefix = 0;
+    for (size_t i = 0; i < PREFIX_BYTES; ++i)
+    {
+        header->prefix <<= 8u;
+        if (i < len)
+        {
+            header->prefix |= (unsigned char) key[i];
+        }
+    }
+    return key;
+}
+
+/**
+ * @param s a string key
+ * @return the key length, without walking the chars
+ */
+size_t stringKeyLength(const char *s)
+{
+    return getStringKeyHeader(s)->len;
+}
+
+/**
+ * CompFunc for string keys made by newStringKey, orders them like stringCompare but decides most comparisons
+ * by the cached prefixes and compares the rest with memcmp of the known lengths
+ * @param a - char* pointer made by newStringKey
+ * @param b - char* pointer made by newStringKey
+ * @return equal to 0 iff a == b. lower than 0 if a < b. Greater than 0 iff b < a. (lexicographic
+ * order)
+ */
+int stringKeyCompare(const void *a, const void *b)
+{
+    const StringKeyHeader *v = getStringKeyHeader((const char *) a);
+    const StringKeyHeader *u = getStringKeyHeader((const char *) b);
+    if (v->prefix != u->prefix)
+    {
+        return v->prefix < u->prefix ? LESS : GREATER;
+    }
+    size_t minLen = v->len < u->len ? v->len : u->len;
+    if (minLen > PREFIX_BYTES)
+    {
+        int cmp = memcmp((const char *) a + PREFIX_BYTES, (const char *) b + PREFIX_BYTES, minLen - PREFIX_BYTES);
+        if (cmp != 0)
+        {
+            return cmp < 0 ? LESS : GREATER;
+        }
+    }
+    if (v->len == u->len)
+    {
+        return EQUAL;
+    }
+    return v->len < u->len ? LESS : GREATER;
+}
+
+/**
+ * FreeFunc for string keys made by newStringKey
+ */
+void freeStringKey(void *s)
+{
+    if (s == NULL)
+    {
+        return;
+    }
+    free(getStringKeyHeader((char *) s));
+}
+
+/**
+ * the buffer of joinRBTree, len is where the next word is appended
+ */
+typedef struct JoinBuffer
+{
+    char *buf;
+    size_t len;
+    size_t capacity;
+} JoinBuffer;
+
+/**
+ * ForEach function that appends the given word and a newline at the tail of a JoinBuffer, growing it if
+ * needed. unlike concatenate it never walks the joined text, so joining a whole tree is linear.
+ * @param word - char* to append
+ * @param pJoin - JoinBuffer*
+ * @return 0 on failure, other on success
+ */
+int appendWord(const void *word, void *pJoin)
+{
+    if (word == NULL)
+    {
+        return FAIL;
+    }
+    JoinBuffer *join = (JoinBuffer *) pJoin;
+    size_t wordLen = strlen((const char *) word);
+    size_t needed = join->len + wordLen + 2;
+    if (needed > join->capacity)
+    {
+        size_t capacity = join->capacity * 2 > needed ? join->capacity * 2 : needed;
+        char *buf = (char *) realloc(join->buf, capacity);
+        if (buf == NULL)
+        {
+            return FAIL;
+        }
+        join->buf = buf;
+        join->capacity = capacity;
+    }
+    memcpy(join->buf + join->len, word, wordLen);
+    join->len += wordLen;
+    join->buf[join->len++] = '\n';
+    join->buf[join->len] = '\0';
+    return SUCCESS;
+}
+
+/**
+ * joins the strings of a tree in order, each followed by a newline (the same text concatenate builds)
+ * @param tree a pointer to a tree of strings
+ * @return the joined string, to be freed with free. NULL on failure
+ */
+char *joinRBTree(RBTree *tree)
+{
+    JoinBuffer join;
+    join.len = 0;
+    join.capacity = MIN_JOIN_CAPACITY;
+    join.buf = (char *) malloc(join.capacity);
+    if (join.buf == NULL)
+    {
+        return NULL;
+    }
+    join.buf[0] = '\0';
+    if (forEachRBTree(tree, appendWord, &join) == FAIL)
+    {
+        free(join.buf);
+        return NULL;
+    }
+    return join.buf;
+}
+
 /**
  * CompFunc for Vectors, compares element by element, the vector that has the first larger
  * element is considered larger. If vectors are of different lengths and identify for the length
@@ -76,42 +344,176 @@ int vectorCompare1By1(const void *a, const void *b)
 {
     Vector *v = (Vector *) a;
     Vector *u = (Vector *) b;
-    int isEq = 0;
-    if (v->len == u->len)
-    {
-        isEq = TRUE;
-    }
     int minLen = v->len;
     if (minLen > u->len)
     {
         minLen = u->len;
     }
-    int i = 0;
-    while (i < minLen)
+    // on random keys the first elements decide most comparisons, so they are checked before calling a kernel
+    if (minLen > 0 && v->vector[0] != u->vector[0])
+    {
+        return v->vector[0] > u->vector[0] ? GREATER : LESS;
+    }
+    int i = minLen == 0 ? 0 : 1 + firstMismatch(v->vector + 1, u->vector + 1, minLen - 1);
+    if (i < minLen)
     {
-        if (v->vector[i] != u->vector[i])
+        if (v->vector[i] > u->vector[i])
         {
-            if (v->vector[i] > u->vector[i])
-            {
-                return GREATER;
-            }
-            return LESS;
+            return GREATER;
         }
-        ++i;
+        return LESS;
     }
-    if (isEq == TRUE)
+    if (v->len == u->len)
     {
         return EQUAL;
     }
-    else
+    if (minLen == v->len)
     {
-        if (minLen == v->len)
-        {
-            return LESS;
-        }
-        return GREATER;
+        return LESS;
+    }
+    return GREATER;
+}
+
+/**
+ * the plain dot product, used when no vector instructions are available and for the tail of the others
+ * @param a first array
+ * @param b second array
+ * @param len the arrays length
+ * @return the dot product
+ */
+double dotProductScalar(const double *a, const double *b, int len)
+{
+    double dot = 0;
+    for (int i = 0; i < len; ++i)
+    {
+        dot += a[i] * b[i];
+    }
+    return dot;
+}
+
+#ifdef X86_KERNELS
+
+/**
+ * dot product with SSE2, two lanes per register and two independent sums
+ * @param a first array
+ * @param b second array
+ * @param len the arrays length
+ * @return the dot product
+ */
+__attribute__((target("sse2"))) double dotProductSse2(const double *a, const double *b, int len)
+{
+    __m128d sum0 = _mm_setzero_pd();
+    __m128d sum1 = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+    return lanes[0] + lanes[1] + dotProductScalar(a + i, b + i, len - i);
+}
+
+/**
+ * dot product with AVX2, four lanes per register and two independent sums
+ * @param a first array
+ * @param b second array
+ * @param len the arrays length
+ * @return the dot product
+ */
+__attribute__((target("avx2"))) double dotProductAvx2(const double *a, const double *b, int len)
+{
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(sum0, sum1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + dotProductScalar(a + i, b + i, len - i);
+}
+
+#endif
+
+/**
+ * dot product of two arrays, using the widest vector instructions the cpu supports. the sums are taken in a
+ * different order than the plain loop, so the result may differ from it in the last bits.
+ * @param a first array
+ * @param b second array
+ * @param len the arrays length
+ * @return the dot product
+ */
+double dotProduct(const double *a, const double *b, int len)
+{
+#ifdef X86_KERNELS
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return dotProductAvx2(a, b, len);
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return dotProductSse2(a, b, len);
+    }
+#endif
+    return dotProductScalar(a, b, len);
+}
+
+/**
+ * the plain squared euclidean distance between two arrays
+ * @param a first array
+ * @param b second array
+ * @param len the arrays length
+ * @return the squared distance
+ */
+double squaredDistanceScalar(const double *a, const double *b, int len)
+{
+    double dist = 0;
+    for (int i = 0; i < len; ++i)
+    {
+        dist += SQUARE(a[i] - b[i]);
+    }
+    return dist;
+}
+
+#ifdef X86_KERNELS
+
+/**
+ * squared distance with AVX2, four lanes per register
+ */
+__attribute__((target("avx2"))) double squaredDistanceAvx2(const double *a, const double *b, int len)
+{
+    __m256d sum = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+        sum = _mm256_add_pd(sum, _mm256_mul_pd(diff, diff));
     }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + squaredDistanceScalar(a + i, b + i, len - i);
 }
+
+#endif
+
+/**
+ * squared euclidean distance of two arrays, with AVX2 when the cpu supports it
+ */
+double squaredDistance(const double *a, const double *b, int len)
+{
+#ifdef X86_KERNELS
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return squaredDistanceAvx2(a, b, len);
+    }
+#endif
+    return squaredDistanceScalar(a, b, len);
+}
+
 /**
  * calculate vector norm
  * @param v the vector
@@ -123,20 +525,37 @@ double calcNorm(const Vector *v)
     {
         return UNDEFINED_SIZE;
     }
-    int len = v->len;
-    double norm = 0;
-    double cur = 0;
-    for (int i = 0; i < len; ++i)
+    return dotProduct(v->vector, v->vector, v->len);
+}
+
+/**
+ * copies the elements of a vector into another one
+ * @param from the vector to copy
+ * @param to the copy, its old elements are freed
+ * @return 1 on success, 0 on failure (to is left empty)
+ */
+int copyVector(const Vector *from, Vector *to)
+{
+    if (to->vector != NULL)
+    {
+        free(to->vector);
+    }
+    to->vector = (double *) malloc(sizeof(double) * from->len);
+    if (to->vector == NULL)
     {
-        cur = SQUARE(v->vector[i]);
-        norm += cur;
+        to->len = 0;
+        return FAIL;
     }
-    return norm;
+    memcpy(to->vector, from->vector, sizeof(double) * from->len);
+    to->len = from->len;
+    return SUCCESS;
 }
 
 /**
  * copy pVector to pMaxVector if : 1. The norm of pVector is greater then the norm of pMaxVector.
  * 								   2. pMaxVector == NULL.
+ * this is the slow path kept for the course API: a Vector has no room to cache its norm, so every call computes
+ * both norms and copies on every improvement. findMaxNormVectorInTree uses trackIfNormIsLarger instead.
  * @param pVector pointer to Vector
  * @param pMaxVector pointer to Vector
  * @return 1 on success, 0 on failure (if pVector == NULL: failure).
@@ -155,72 +574,1167 @@ int copyIfNormIsLarger(const void *pVector, void *pMaxVector)
     Vector *maxVec = (Vector *) pMaxVector;
     if (maxVec->vector == NULL || calcNorm(maxVec) < calcNorm(toCopy))
     {
-        if (maxVec->vector != NULL)
-        {
-            free(maxVec->vector);
-        }
-        maxVec->vector = (double *) malloc(sizeof(double) * toCopy->len);
-        if (maxVec->vector == NULL)
-        {
-            free(maxVec);
-            return FAIL;
-        }
-        for (int i = 0; i < toCopy->len; ++i)
-        {
-            maxVec->vector[i] = toCopy->vector[i];
-        }
-        maxVec->len = toCopy->len;
+        return copyVector(toCopy, maxVec);
     }
     return SUCCESS;
 }
 
 /**
- * @param tree a pointer to a tree of Vectors
- * @return pointer to a *copy* of the vector that has the largest norm (L2 Norm).
- * // implement it in Structs.c You must use copyIfNormIsLarger in the implementation!
+ * the running maximum of findMaxNormVectorInTree. it points at the winning vector inside the tree and keeps its
+ * norm, so nothing is copied until the traversal is over.
  */
-Vector *findMaxNormVectorInTree(RBTree *tree)
+typedef struct NormAccumulator
+{
+    const Vector *maxVec;
+    double maxNorm;
+} NormAccumulator;
+
+/**
+ * ForEach function which works like copyIfNormIsLarger on a NormAccumulator, computing one norm per vector and
+ * copying nothing
+ * @param pVector pointer to Vector
+ * @param pAccumulator pointer to NormAccumulator
+ * @return 1 on success, 0 on failure (if pVector == NULL: failure).
+ */
+int trackIfNormIsLarger(const void *pVector, void *pAccumulator)
+{
+    const Vector *vec = (Vector *) pVector;
+    if (vec == NULL || vec->vector == NULL)
+    {
+        return FAIL;
+    }
+    NormAccumulator *acc = (NormAccumulator *) pAccumulator;
+    double norm = calcNorm(vec);
+    if (acc->maxVec == NULL || acc->maxNorm < norm)
+    {
+        acc->maxVec = vec;
+        acc->maxNorm = norm;
+    }
+    return SUCCESS;
+}
+
+/**
+ * @param v the vector to copy, may be NULL
+ * @return a new copy of v (an empty vector if v is NULL), NULL on failure
+ */
+Vector *newVectorCopy(const Vector *v)
 {
-    Vector *cur = (Vector *) malloc(sizeof(Vector));
-    if (cur == NULL)
+    Vector *copy = (Vector *) malloc(sizeof(Vector));
+    if (copy == NULL)
     {
         return NULL;
     }
-    cur->len = 0;
-    cur->vector = NULL;
-    Vector *pMaxNorm = (Vector *) cur;
-    int flag = forEachRBTree(tree, copyIfNormIsLarger, pMaxNorm);
-    if (flag == FAIL)
+    copy->len = 0;
+    copy->vector = NULL;
+    if (v != NULL && copyVector(v, copy) == FAIL)
     {
+        free(copy);
         return NULL;
     }
-    return pMaxNorm;
+    return copy;
 }
 
 /**
- * FreeFunc for strings
+ * @param tree a pointer to a tree of Vectors
+ * @return pointer to a *copy* of the vector that has the largest norm (L2 Norm).
+ * the traversal keeps the running maximum in a NormAccumulator (see trackIfNormIsLarger), so each vector's norm is
+ * computed once and only the final vector is copied.
  */
-void freeString(void *s)
+Vector *findMaxNormVectorInTree(RBTree *tree)
 {
-    if (s == NULL)
+    NormAccumulator acc;
+    acc.maxVec = NULL;
+    acc.maxNorm = 0;
+    if (forEachRBTree(tree, trackIfNormIsLarger, &acc) == FAIL)
     {
-        return;
+        return NULL;
     }
-    free(s);
+    return newVectorCopy(acc.maxVec);
 }
 
 /**
- * FreeFunc for vectors
+ * same as findMaxNormVectorInTree, but every thread finds the max of its own chunk of the tree and the chunk
+ * results are combined in order, so ties are broken the same way.
+ * @param tree a pointer to a tree of Vectors
+ * @param threads the number of threads to use (at most MAX_THREADS)
+ * @return pointer to a *copy* of the vector with the largest norm (an empty Vector for an empty tree), NULL on failure
  */
-void freeVector(void *pVector)
+Vector *findMaxNormVectorInTreeParallel(RBTree *tree, int threads)
 {
-    Vector *node = (Vector *) pVector;
-    if (node != NULL)
+    if (threads < 1 || threads > MAX_THREADS)
     {
-        if (node->vector != NULL)
-        {
-            free(node->vector);
-        }
+        return NULL;
+    }
+    NormAccumulator partial[MAX_THREADS];
+    void *args[MAX_THREADS];
+    for (int i = 0; i < threads; ++i)
+    {
+        partial[i].maxVec = NULL;
+        partial[i].maxNorm = 0;
+        args[i] = &partial[i];
+    }
+    if (forEachRBTreeParallel(tree, trackIfNormIsLarger, args, threads) == FAIL)
+    {
+        return NULL;
+    }
+    int best = 0;
+    for (int i = 1; i < threads; ++i)
+    {
+        if (partial[i].maxVec != NULL &&
+            (partial[best].maxVec == NULL || partial[best].maxNorm < partial[i].maxNorm))
+        {
+            best = i;
+        }
+    }
+    return newVectorCopy(partial[best].maxVec);
+}
+
+/**
+ * a bounded min heap of the k largest norms seen so far, the smallest of them at the top
+ */
+typedef struct NormHeap
+{
+    NormAccumulator *items;
+    int size;
+    int capacity;
+} NormHeap;
+
+/**
+ * moves the item at index i down until the heap order holds again
+ * @param heap the heap
+ * @param i the index to fix
+ */
+void siftDown(NormHeap *heap, int i)
+{
+    NormAccumulator *items = heap->items;
+    while (2 * i + 1 < heap->size)
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < heap->size && items[child + 1].maxNorm < items[child].maxNorm)
+        {
+            ++child;
+        }
+        if (items[i].maxNorm <= items[child].maxNorm)
+        {
+            return;
+        }
+        NormAccumulator tmp = items[i];
+        items[i] = items[child];
+        items[child] = tmp;
+        i = child;
+    }
+}
+
+/**
+ * ForEach function that keeps the vector in the NormHeap if its norm is among the k largest so far. on equal
+ * norms the vector seen first is kept.
+ * @param pVector pointer to Vector
+ * @param pHeap pointer to NormHeap
+ * @return 1 on success, 0 on failure (if pVector == NULL: failure).
+ */
+int keepIfNormIsTopK(const void *pVector, void *pHeap)
+{
+    const Vector *vec = (Vector *) pVector;
+    if (vec == NULL || vec->vector == NULL)
+    {
+        return FAIL;
+    }
+    NormHeap *heap = (NormHeap *) pHeap;
+    double norm = calcNorm(vec);
+    if (heap->size < heap->capacity)
+    {
+        int i = heap->size++;
+        while (i > 0 && norm < heap->items[(i - 1) / 2].maxNorm)
+        {
+            heap->items[i] = heap->items[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap->items[i].maxVec = vec;
+        heap->items[i].maxNorm = norm;
+    }
+    else if (heap->items[0].maxNorm < norm)
+    {
+        heap->items[0].maxVec = vec;
+        heap->items[0].maxNorm = norm;
+        siftDown(heap, 0);
+    }
+    return SUCCESS;
+}
+
+/**
+ * finds the k vectors with the largest norms in one pass, keeping only k pointers on the way and copying the
+ * winners once at the end.
+ * @param tree a pointer to a tree of Vectors
+ * @param k how many vectors to find
+ * @param found out parameter, the number of vectors returned (less than k if the tree is smaller)
+ * @return an array of *copies* of the vectors, the largest norm first, NULL on failure. every vector should
+ * be freed with freeVector and then the array itself with free.
+ */
+Vector **findTopKNormVectorsInTree(RBTree *tree, int k, int *found)
+{
+    if (k < 1 || found == NULL)
+    {
+        return NULL;
+    }
+    NormHeap heap;
+    heap.size = 0;
+    heap.capacity = k;
+    heap.items = (NormAccumulator *) malloc(sizeof(NormAccumulator) * k);
+    if (heap.items == NULL)
+    {
+        return NULL;
+    }
+    Vector **result = NULL;
+    if (forEachRBTree(tree, keepIfNormIsTopK, &heap) == SUCCESS)
+    {
+        result = (Vector **) malloc(sizeof(Vector *) * (heap.size > 0 ? heap.size : 1));
+    }
+    int count = heap.size;
+    for (int i = count - 1; result != NULL && i >= 0; --i)
+    {
+        const Vector *smallest = heap.items[0].maxVec;
+        heap.items[0] = heap.items[--heap.size];
+        siftDown(&heap, 0);
+        result[i] = newVectorCopy(smallest);
+        if (result[i] == NULL)
+        {
+            for (int j = i + 1; j < count; ++j)
+            {
+                freeVector(result[j]);
+            }
+            free(result);
+            result = NULL;
+        }
+    }
+    free(heap.items);
+    if (result != NULL)
+    {
+        *found = count;
+    }
+    return result;
+}
+
+/**
+ * FreeFunc for strings
+ */
+void freeString(void *s)
+{
+    if (s == NULL)
+    {
+        return;
+    }
+    free(s);
+}
+
+/**
+ * FreeFunc for vectors
+ */
+void freeVector(void *pVector)
+{
+    Vector *node = (Vector *) pVector;
+    if (node != NULL)
+    {
+        if (node->vector != NULL)
+        {
+            free(node->vector);
+        }
         free(pVector);
     }
 }
+
+/**
+ * one block of a VectorArena. the vector headers come right after the values, in the same allocation.
+ */
+typedef struct ArenaChunk
+{
+    struct ArenaChunk *next;
+    Vector *headers;
+    int count;
+    int capacity;
+    size_t used;
+    size_t valueCapacity;
+    double values[];
+} ArenaChunk;
+
+/**
+ * a store which keeps vectors back to back in large chunks: the elements of all vectors in one array and their
+ * headers in another. the vectors never move, so they can be added to an RBTree with freeArenaVector as its
+ * FreeFunc, and are all released at once by freeVectorArena.
+ */
+struct VectorArena
+{
+    ArenaChunk *first;
+    ArenaChunk *last;
+    int chunkVectors;
+    size_t chunkValues;
+};
+
+/**
+ * @param chunkVectors how many vectors a chunk holds, 0 for the default
+ * @param chunkValues how many elements a chunk holds, 0 for the default (longer vectors get a chunk of their
+ * own)
+ * @return a new empty arena, NULL on failure
+ */
+VectorArena *newVectorArena(int chunkVectors, size_t chunkValues)
+{
+    VectorArena *arena = (VectorArena *) malloc(sizeof(VectorArena));
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    arena->first = NULL;
+    arena->last = NULL;
+    arena->chunkVectors = chunkVectors > 0 ? chunkVectors : DEFAULT_ARENA_VECTORS;
+    arena->chunkValues = chunkValues > 0 ? chunkValues : DEFAULT_ARENA_VALUES;
+    return arena;
+}
+
+/**
+ * @param arena the arena
+ * @param len the length of the vector about to be added
+ * @return a chunk with room for the vector, NULL on failure
+ */
+ArenaChunk *getArenaChunk(VectorArena *arena, int len)
+{
+    ArenaChunk *chunk = arena->last;
+    if (chunk != NULL && chunk->count < chunk->capacity && chunk->used + len <= chunk->valueCapacity)
+    {
+        return chunk;
+    }
+    size_t values = (size_t) len > arena->chunkValues ? (size_t) len : arena->chunkValues;
+    chunk = (ArenaChunk *) malloc(sizeof(ArenaChunk) + sizeof(double) * values +
+                                  sizeof(Vector) * arena->chunkVectors);
+    if (chunk == NULL)
+    {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->headers = (Vector *) (chunk->values + values);
+    chunk->count = 0;
+    chunk->capacity = arena->chunkVectors;
+    chunk->used = 0;
+    chunk->valueCapacity = values;
+    if (arena->last == NULL)
+    {
+        arena->first = chunk;
+    }
+    else
+    {
+        arena->last->next = chunk;
+    }
+    arena->last = chunk;
+    return chunk;
+}
+
+/**
+ * copies a vector into the arena
+ * @param arena the arena
+ * @param values the vector elements
+ * @param len the vector length
+ * @return the vector inside the arena, valid until freeVectorArena. NULL on failure
+ */
+Vector *arenaAddVector(VectorArena *arena, const double *values, int len)
+{
+    if (arena == NULL || len < 0 || (values == NULL && len > 0))
+    {
+        return NULL;
+    }
+    ArenaChunk *chunk = getArenaChunk(arena, len);
+    if (chunk == NULL)
+    {
+        return NULL;
+    }
+    Vector *v = &chunk->headers[chunk->count++];
+    v->vector = chunk->values + chunk->used;
+    v->len = len;
+    if (len > 0)
+    {
+        memcpy(v->vector, values, sizeof(double) * len);
+    }
+    chunk->used += len;
+    return v;
+}
+
+/**
+ * FreeFunc for vectors which live in a VectorArena, does nothing since the arena owns them
+ */
+void freeArenaVector(void *pVector)
+{
+    (void) pVector;
+}
+
+/**
+ * same as findMaxNormVectorInTree, but scans the arena memory in order instead of walking a tree. on equal
+ * norms the vector added first wins.
+ * @param arena the arena
+ * @return pointer to a *copy* of the vector that has the largest norm, NULL on failure
+ */
+Vector *findMaxNormVectorInArena(VectorArena *arena)
+{
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    NormAccumulator acc;
+    acc.maxVec = NULL;
+    acc.maxNorm = 0;
+    for (ArenaChunk *chunk = arena->first; chunk != NULL; chunk = chunk->next)
+    {
+        for (int i = 0; i < chunk->count; ++i)
+        {
+            trackIfNormIsLarger(&chunk->headers[i], &acc);
+        }
+    }
+    return newVectorCopy(acc.maxVec);
+}
+
+/**
+ * frees the arena and every vector in it. a tree holding its vectors should be freed first.
+ */
+void freeVectorArena(VectorArena *arena)
+{
+    if (arena == NULL)
+    {
+        return;
+    }
+    ArenaChunk *chunk = arena->first;
+    while (chunk != NULL)
+    {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+/**
+ * a vector found by a nearest neighbour search, index is its position in the tree order
+ */
+typedef struct Neighbour
+{
+    const Vector *v;
+    double dist;
+    int index;
+} Neighbour;
+
+/**
+ * a bounded max heap of the k nearest vectors seen so far, the farthest of them at the top. vectors at the
+ * same distance are ordered by their index, so every search returns the same neighbours.
+ */
+typedef struct NeighbourHeap
+{
+    Neighbour *items;
+    int size;
+    int capacity;
+    const Vector *query;
+    int visited;
+} NeighbourHeap;
+
+/**
+ * @return 1 if a is farther than b, 0 otherwise
+ */
+int isFarther(const Neighbour *a, const Neighbour *b)
+{
+    return a->dist > b->dist || (a->dist == b->dist && a->index > b->index);
+}
+
+/**
+ * moves the item at index i down until the heap order holds again
+ * @param heap the heap
+ * @param i the index to fix
+ */
+void siftDownNeighbour(NeighbourHeap *heap, int i)
+{
+    Neighbour *items = heap->items;
+    while (2 * i + 1 < heap->size)
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < heap->size && isFarther(&items[child + 1], &items[child]))
+        {
+            ++child;
+        }
+        if (!isFarther(&items[child], &items[i]))
+        {
+            return;
+        }
+        Neighbour tmp = items[i];
+        items[i] = items[child];
+        items[child] = tmp;
+        i = child;
+    }
+}
+
+/**
+ * offers a vector to the heap, which keeps it if it is among the k nearest so far
+ * @param heap the heap
+ * @param n the vector and its distance
+ */
+void offerNeighbour(NeighbourHeap *heap, Neighbour n)
+{
+    Neighbour *items = heap->items;
+    if (heap->size < heap->capacity)
+    {
+        int i = heap->size++;
+        while (i > 0 && isFarther(&n, &items[(i - 1) / 2]))
+        {
+            items[i] = items[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        items[i] = n;
+    }
+    else if (isFarther(&items[0], &n))
+    {
+        items[0] = n;
+        siftDownNeighbour(heap, 0);
+    }
+}
+
+/**
+ * empties the heap into out, the nearest first
+ * @param heap the heap
+ * @param out the array to fill, at least heap->size long
+ * @param found out parameter, the number of vectors written
+ */
+void drainNeighbours(NeighbourHeap *heap, const Vector **out, int *found)
+{
+    *found = heap->size;
+    while (heap->size > 0)
+    {
+        out[heap->size - 1] = heap->items[0].v;
+        heap->items[0] = heap->items[--heap->size];
+        siftDownNeighbour(heap, 0);
+    }
+}
+
+/**
+ * ForEach function of kNearestBruteForce, offers every vector to the NeighbourHeap
+ * @param pVector pointer to Vector
+ * @param pHeap pointer to NeighbourHeap
+ * @return 1 on success, 0 on failure (the vector is NULL or its length differs from the query).
+ */
+int offerIfNearer(const void *pVector, void *pHeap)
+{
+    const Vector *vec = (Vector *) pVector;
+    NeighbourHeap *heap = (NeighbourHeap *) pHeap;
+    if (vec == NULL || vec->vector == NULL || vec->len != heap->query->len)
+    {
+        return FAIL;
+    }
+    Neighbour n;
+    n.v = vec;
+    n.dist = squaredDistance(vec->vector, heap->query->vector, vec->len);
+    n.index = heap->visited++;
+    offerNeighbour(heap, n);
+    return SUCCESS;
+}
+
+/**
+ * the exact k nearest neighbours of q, found by measuring the distance to every vector in the tree
+ * @param tree a pointer to a tree of Vectors, all of the same length as q
+ * @param q the query
+ * @param k how many neighbours to find
+ * @param out array of at least k pointers, filled with the neighbours (vectors of the tree), the nearest first.
+ * vectors at the same distance are in tree order.
+ * @param found out parameter, the number of neighbours written (less than k if the tree is smaller)
+ * @return 1 on success, 0 on failure
+ */
+int kNearestBruteForce(RBTree *tree, const Vector *q, int k, const Vector **out, int *found)
+{
+    if (q == NULL || q->vector == NULL || k < 1 || out == NULL || found == NULL)
+    {
+        return FAIL;
+    }
+    NeighbourHeap heap;
+    heap.items = (Neighbour *) malloc(sizeof(Neighbour) * k);
+    if (heap.items == NULL)
+    {
+        return FAIL;
+    }
+    heap.size = 0;
+    heap.capacity = k;
+    heap.query = q;
+    heap.visited = 0;
+    int flag = forEachRBTree(tree, offerIfNearer, &heap);
+    if (flag == SUCCESS)
+    {
+        drainNeighbours(&heap, out, found);
+    }
+    free(heap.items);
+    return flag;
+}
+
+/**
+ * a KD tree over the vectors of an RBTree. the points are kept in one array where the median of every range
+ * is the node that splits it, its left half is the left subtree and its right half the right one.
+ */
+struct KdTree
+{
+    Neighbour *points;
+    int count;
+    int dim;
+};
+
+/**
+ * ForEach function of newKdTree, appends the vector to the KdTree points in tree order
+ * @param pVector pointer to Vector
+ * @param pKdTree pointer to KdTree
+ * @return 1 on success, 0 on failure (the vector is NULL or its length differs from the others).
+ */
+int collectPoint(const void *pVector, void *pKdTree)
+{
+    const Vector *vec = (Vector *) pVector;
+    KdTree *kd = (KdTree *) pKdTree;
+    if (vec == NULL || vec->vector == NULL || vec->len == 0 || (kd->count > 0 && vec->len != kd->dim))
+    {
+        return FAIL;
+    }
+    kd->dim = vec->len;
+    kd->points[kd->count].v = vec;
+    kd->points[kd->count].dist = 0;
+    kd->points[kd->count].index = kd->count;
+    ++kd->count;
+    return SUCCESS;
+}
+
+/**
+ * reorders points[low..high) so the item at mid has its final place by the axis coordinate, the smaller ones
+ * before it and the larger ones after it (quickselect)
+ */
+void selectMedian(Neighbour *points, int low, int high, int mid, int axis)
+{
+    while (high - low > 1)
+    {
+        double pivot = points[low + (high - low) / 2].v->vector[axis];
+        int i = low;
+        int j = high - 1;
+        while (i <= j)
+        {
+            while (points[i].v->vector[axis] < pivot)
+            {
+                ++i;
+            }
+            while (points[j].v->vector[axis] > pivot)
+            {
+                --j;
+            }
+            if (i <= j)
+            {
+                Neighbour tmp = points[i];
+                points[i++] = points[j];
+                points[j--] = tmp;
+            }
+        }
+        if (mid <= j)
+        {
+            high = j + 1;
+        }
+        else if (mid >= i)
+        {
+            low = i;
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * builds the KD tree of points[low..high), splitting on the axis depth % dim
+ */
+void buildKdTree(KdTree *kd, int low, int high, int depth)
+{
+    if (high - low < 2)
+    {
+        return;
+    }
+    int mid = low + (high - low) / 2;
+    int axis = depth % kd->dim;
+    selectMedian(kd->points, low, high, mid, axis);
+    buildKdTree(kd, low, mid, depth + 1);
+    buildKdTree(kd, mid + 1, high, depth + 1);
+}
+
+/**
+ * builds a KD tree over the vectors of an RBTree. the KD tree points at the vectors of the RBTree, so it must be
+ * freed before the RBTree is changed or freed.
+ * @param tree a pointer to a tree of Vectors, all of the same (positive) length
+ * @return the KD tree, NULL on failure
+ */
+KdTree *newKdTree(RBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    KdTree *kd = (KdTree *) malloc(sizeof(KdTree));
+    if (kd == NULL)
+    {
+        return NULL;
+    }
+    kd->count = 0;
+    kd->dim = 0;
+    kd->points = (Neighbour *) malloc(sizeof(Neighbour) * (tree->size > 0 ? tree->size : 1));
+    if (kd->points == NULL || forEachRBTree(tree, collectPoint, kd) == FAIL)
+    {
+        free(kd->points);
+        free(kd);
+        return NULL;
+    }
+    buildKdTree(kd, 0, kd->count, 0);
+    return kd;
+}
+
+/**
+ * offers the points of the subtree points[low..high) to the heap, skipping subtrees that are farther than the
+ * farthest neighbour found so far
+ */
+void searchKdTree(const KdTree *kd, NeighbourHeap *heap, int low, int high, int depth)
+{
+    while (high > low)
+    {
+        int mid = low + (high - low) / 2;
+        Neighbour n = kd->points[mid];
+        n.dist = squaredDistance(n.v->vector, heap->query->vector, kd->dim);
+        offerNeighbour(heap, n);
+        double diff = heap->query->vector[depth % kd->dim] - n.v->vector[depth % kd->dim];
+        int nearLow = diff < 0 ? low : mid + 1;
+        int nearHigh = diff < 0 ? mid : high;
+        searchKdTree(kd, heap, nearLow, nearHigh, depth + 1);
+        if (heap->size == heap->capacity && SQUARE(diff) > heap->items[0].dist)
+        {
+            return;
+        }
+        low = diff < 0 ? mid + 1 : low;
+        high = diff < 0 ? high : mid;
+        ++depth;
+    }
+}
+
+/**
+ * the k nearest neighbours of q, same as kNearestBruteForce but only visiting the parts of the KD tree that may
+ * hold them
+ * @param kd the KD tree
+ * @param q the query, of the same length as the KD tree vectors
+ * @param k how many neighbours to find
+ * @param out array of at least k pointers, filled with the neighbours, the nearest first. vectors at the same
+ * distance are in tree order.
+ * @param found out parameter, the number of neighbours written (less than k if the tree is smaller)
+ * @return 1 on success, 0 on failure
+ */
+int kNearest(const KdTree *kd, const Vector *q, int k, const Vector **out, int *found)
+{
+    if (kd == NULL || q == NULL || q->vector == NULL || k < 1 || out == NULL || found == NULL ||
+        (kd->count > 0 && q->len != kd->dim))
+    {
+        return FAIL;
+    }
+    NeighbourHeap heap;
+    heap.items = (Neighbour *) malloc(sizeof(Neighbour) * k);
+    if (heap.items == NULL)
+    {
+        return FAIL;
+    }
+    heap.size = 0;
+    heap.capacity = k;
+    heap.query = q;
+    heap.visited = 0;
+    searchKdTree(kd, &heap, 0, kd->count, 0);
+    drainNeighbours(&heap, out, found);
+    free(heap.items);
+    return SUCCESS;
+}
+
+/**
+ * frees the KD tree, the vectors themselves belong to the RBTree
+ */
+void freeKdTree(KdTree *kd)
+{
+    if (kd == NULL)
+    {
+        return;
+    }
+    free(kd->points);
+    free(kd);
+}
+
+/**
+ * the header of a saved tree. the file is the header, then the items back to back in tree order (strings with
+ * their '\0', vectors as their doubles), then count + 1 offsets of the items from the start of the file, the
+ * last one being the end of the items. numbers are stored in the machine byte order.
+ */
+typedef struct FileHeader
+{
+    char magic[4];
+    uint32_t kind;
+    uint64_t count;
+    uint64_t offsetsPos;
+} FileHeader;
+
+/**
+ * the state of a save, pos is the offset of the next item
+ */
+typedef struct TreeWriter
+{
+    FILE *file;
+    uint32_t kind;
+    uint64_t *offsets;
+    uint64_t count;
+    uint64_t capacity;
+    uint64_t pos;
+} TreeWriter;
+
+/**
+ * ForEach function that writes a string or a vector to the TreeWriter file and records its offset
+ * @param item - char* or Vector*, by the writer kind
+ * @param pWriter - TreeWriter*
+ * @return 0 on failure, other on success
+ */
+int writeItem(const void *item, void *pWriter)
+{
+    TreeWriter *writer = (TreeWriter *) pWriter;
+    if (item == NULL)
+    {
+        return FAIL;
+    }
+    if (writer->count + 1 >= writer->capacity)
+    {
+        uint64_t capacity = writer->capacity * 2;
+        uint64_t *offsets = (uint64_t *) realloc(writer->offsets, sizeof(uint64_t) * capacity);
+        if (offsets == NULL)
+        {
+            return FAIL;
+        }
+        writer->offsets = offsets;
+        writer->capacity = capacity;
+    }
+    const void *bytes = item;
+    size_t len = 0;
+    if (writer->kind == STRING_ITEMS)
+    {
+        len = strlen((const char *) item) + 1;
+    }
+    else
+    {
+        const Vector *vec = (const Vector *) item;
+        if (vec->vector == NULL && vec->len > 0)
+        {
+            return FAIL;
+        }
+        bytes = vec->vector;
+        len = sizeof(double) * vec->len;
+    }
+    if (len > 0 && fwrite(bytes, 1, len, writer->file) != len)
+    {
+        return FAIL;
+    }
+    writer->offsets[writer->count++] = writer->pos;
+    writer->pos += len;
+    return SUCCESS;
+}
+
+/**
+ * writes the items of a tree to a file, in one pass over the tree
+ * @param tree the tree
+ * @param path the file to create (or overwrite)
+ * @param kind STRING_ITEMS or VECTOR_ITEMS
+ * @return 1 on success, 0 on failure
+ */
+int saveRBTree(RBTree *tree, const char *path, uint32_t kind)
+{
+    if (tree == NULL || path == NULL)
+    {
+        return FAIL;
+    }
+    TreeWriter writer;
+    writer.file = fopen(path, "wb");
+    if (writer.file == NULL)
+    {
+        return FAIL;
+    }
+    writer.kind = kind;
+    writer.count = 0;
+    writer.capacity = MIN_JOIN_CAPACITY;
+    writer.pos = sizeof(FileHeader);
+    writer.offsets = (uint64_t *) malloc(sizeof(uint64_t) * writer.capacity);
+    FileHeader header;
+    memset(&header, 0, sizeof(FileHeader));
+    int flag = writer.offsets != NULL && fwrite(&header, sizeof(FileHeader), 1, writer.file) == 1 &&
+               forEachRBTree(tree, writeItem, &writer) == SUCCESS;
+    if (flag)
+    {
+        writer.offsets[writer.count] = writer.pos;
+        size_t padding = (sizeof(uint64_t) - writer.pos % sizeof(uint64_t)) % sizeof(uint64_t);
+        uint64_t zero = 0;
+        memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+        header.kind = kind;
+        header.count = writer.count;
+        header.offsetsPos = writer.pos + padding;
+        flag = fwrite(&zero, 1, padding, writer.file) == padding &&
+               fwrite(writer.offsets, sizeof(uint64_t), writer.count + 1, writer.file) == writer.count + 1 &&
+               fseek(writer.file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(FileHeader), 1, writer.file) == 1;
+    }
+    free(writer.offsets);
+    if (fclose(writer.file) != 0)
+    {
+        flag = FAIL;
+    }
+    return flag ? SUCCESS : FAIL;
+}
+
+/**
+ * writes a tree of strings to a file, which loadStringRBTree or mapRBTreeFile can read back
+ * @return 1 on success, 0 on failure
+ */
+int saveStringRBTree(RBTree *tree, const char *path)
+{
+    return saveRBTree(tree, path, STRING_ITEMS);
+}
+
+/**
+ * writes a tree of vectors to a file, which loadVectorRBTree or mapRBTreeFile can read back
+ * @return 1 on success, 0 on failure
+ */
+int saveVectorRBTree(RBTree *tree, const char *path)
+{
+    return saveRBTree(tree, path, VECTOR_ITEMS);
+}
+
+/**
+ * a saved tree mapped into memory, which answers lookups by binary search on the file itself
+ */
+struct MappedRBTree
+{
+    const char *base;
+    size_t size;
+    uint32_t kind;
+    uint64_t count;
+    const uint64_t *offsets;
+};
+
+/**
+ * maps a file written by saveStringRBTree or saveVectorRBTree, checking that it is well formed
+ * @param path the file
+ * @return the mapped tree, NULL on failure
+ */
+MappedRBTree *mapRBTreeFile(const char *path)
+{
+    if (path == NULL)
+    {
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat st;
+    MappedRBTree *mapped = (MappedRBTree *) malloc(sizeof(MappedRBTree));
+    void *base = MAP_FAILED;
+    if (mapped != NULL && fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(FileHeader))
+    {
+        base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        free(mapped);
+        return NULL;
+    }
+    mapped->base = (const char *) base;
+    mapped->size = (size_t) st.st_size;
+    const FileHeader *header = (const FileHeader *) base;
+    mapped->kind = header->kind;
+    mapped->count = header->count;
+    mapped->offsets = (const uint64_t *) (mapped->base + header->offsetsPos);
+    int isOk = memcmp(header->magic, FILE_MAGIC, sizeof(header->magic)) == 0 &&
+               (header->kind == STRING_ITEMS || header->kind == VECTOR_ITEMS) &&
+               header->offsetsPos % sizeof(uint64_t) == 0 && header->offsetsPos <= mapped->size &&
+               header->count < (mapped->size - header->offsetsPos) / sizeof(uint64_t);
+    uint64_t prev = sizeof(FileHeader);
+    for (uint64_t i = 0; isOk && i <= header->count; ++i)
+    {
+        uint64_t offset = mapped->offsets[i];
+        isOk = offset >= prev && offset <= header->offsetsPos;
+        if (isOk && i > 0 && header->kind == STRING_ITEMS)
+        {
+            isOk = offset > prev && mapped->base[offset - 1] == '\0';
+        }
+        else if (isOk && i > 0)
+        {
+            isOk = (offset - prev) % sizeof(double) == 0 && (offset - prev) / sizeof(double) <= INT32_MAX;
+        }
+        prev = offset;
+    }
+    if (!isOk)
+    {
+        munmap(base, mapped->size);
+        free(mapped);
+        return NULL;
+    }
+    return mapped;
+}
+
+/**
+ * @param mapped the mapped tree
+ * @param i the item index
+ * @return a view of the i-th vector of a mapped vector file, pointing into the file
+ */
+Vector mappedVector(const MappedRBTree *mapped, uint64_t i)
+{
+    Vector v;
+    v.vector = (double *) (mapped->base + mapped->offsets[i]);
+    v.len = (int) ((mapped->offsets[i + 1] - mapped->offsets[i]) / sizeof(double));
+    return v;
+}
+
+/**
+ * @param mapped the mapped tree
+ * @param i the item index
+ * @param key the key to compare to
+ * @return the order of the i-th item relative to key, like a CompareFunc
+ */
+int compareMapped(const MappedRBTree *mapped, uint64_t i, const void *key)
+{
+    if (mapped->kind == STRING_ITEMS)
+    {
+        return stringCompare(mapped->base + mapped->offsets[i], key);
+    }
+    Vector v = mappedVector(mapped, i);
+    return vectorCompare1By1(&v, key);
+}
+
+/**
+ * checks whether a mapped tree contains the given item, without loading the tree
+ * @param mapped the mapped tree
+ * @param key a char* for a string file or a Vector* for a vector file
+ * @return 0 if the item is not in the tree, other if it is.
+ */
+int mappedContains(const MappedRBTree *mapped, const void *key)
+{
+    if (mapped == NULL || key == NULL)
+    {
+        return FAIL;
+    }
+    uint64_t low = 0;
+    uint64_t high = mapped->count;
+    while (low < high)
+    {
+        uint64_t mid = low + (high - low) / 2;
+        int comp = compareMapped(mapped, mid, key);
+        if (comp == EQUAL)
+        {
+            return SUCCESS;
+        }
+        if (comp < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return FAIL;
+}
+
+/**
+ * unmaps a tree mapped by mapRBTreeFile
+ */
+void unmapRBTreeFile(MappedRBTree *mapped)
+{
+    if (mapped == NULL)
+    {
+        return;
+    }
+    munmap((void *) mapped->base, mapped->size);
+    free(mapped);
+}
+
+/**
+ * copies the i-th item of a mapped tree into a new string or Vector
+ * @return the copy, NULL on failure
+ */
+void *copyMappedItem(const MappedRBTree *mapped, uint64_t i)
+{
+    if (mapped->kind == STRING_ITEMS)
+    {
+        return strdup(mapped->base + mapped->offsets[i]);
+    }
+    Vector v = mappedVector(mapped, i);
+    Vector *copy = (Vector *) malloc(sizeof(Vector));
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    copy->len = v.len;
+    copy->vector = (double *) malloc(sizeof(double) * (v.len > 0 ? v.len : 1));
+    if (copy->vector == NULL)
+    {
+        free(copy);
+        return NULL;
+    }
+    memcpy(copy->vector, v.vector, sizeof(double) * v.len);
+    return copy;
+}
+
+/**
+ * loads a saved tree, copying its items out of the mapped file and building the tree from them in linear time
+ * @param path the file
+ * @param kind STRING_ITEMS or VECTOR_ITEMS
+ * @return the tree, NULL on failure (or if the file holds the other kind)
+ */
+RBTree *loadRBTree(const char *path, uint32_t kind)
+{
+    MappedRBTree *mapped = mapRBTreeFile(path);
+    if (mapped == NULL)
+    {
+        return NULL;
+    }
+    FreeFunc freeFunc = kind == STRING_ITEMS ? freeString : freeVector;
+    CompareFunc compFunc = kind == STRING_ITEMS ? stringCompare : vectorCompare1By1;
+    void **items = mapped->kind == kind ? (void **) malloc(sizeof(void *) * (mapped->count + 1)) : NULL;
+    uint64_t copied = 0;
+    while (items != NULL && copied < mapped->count)
+    {
+        items[copied] = copyMappedItem(mapped, copied);
+        if (items[copied] == NULL)
+        {
+            break;
+        }
+        ++copied;
+    }
+    RBTree *tree = NULL;
+    if (items != NULL && copied == mapped->count)
+    {
+        tree = newRBTreeFromSorted(compFunc, freeFunc, items, mapped->count);
+    }
+    if (tree == NULL && items != NULL)
+    {
+        for (uint64_t i = 0; i < copied; ++i)
+        {
+            freeFunc(items[i]);
+        }
+    }
+    free(items);
+    unmapRBTreeFile(mapped);
+    return tree;
+}
+
+/**
+ * loads a tree of strings saved by saveStringRBTree
+ * @return the tree, NULL on failure
+ */
+RBTree *loadStringRBTree(const char *path)
+{
+    return loadRBTree(path, STRING_ITEMS);
+}
+
+/**
+ * loads a tree of vectors saved by saveVectorRBTree
+ * @return the tree, NULL on failure
+ */
+RBTree *loadVectorRBTree(const char *path)
+{
+    return loadRBTree(path, VECTOR_ITEMS);
+}
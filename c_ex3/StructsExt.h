@@ -0,0 +1,160 @@
+/**
+ * @file StructsExt.h
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 12 Dec 2019
+ *
+ * @brief The Structs functions beyond the ones declared by Structs.h
+ *
+ * @section DESCRIPTION
+ * Structs.h is given by the exercise and can't change, so the rest of the public functions of Structs.c are
+ * declared here. The doc comments in Structs.c have the details.
+ */
+#ifndef STRUCTS_EXT_H
+#define STRUCTS_EXT_H
+
+#include <stddef.h>
+#include "Structs.h"
+
+typedef struct VectorArena VectorArena;
+
+typedef struct KdTree KdTree;
+
+typedef struct MappedRBTree MappedRBTree;
+
+/**
+ * finds the vector with the largest norm on several threads
+ * @return a copy of the vector, to be freed with freeVector. an empty Vector for an empty tree, NULL on failure.
+ */
+Vector *findMaxNormVectorInTreeParallel(RBTree *tree, int threads);
+
+/**
+ * finds the k vectors with the largest norms
+ * @param found set to the number of vectors returned
+ * @return copies of the vectors by descending norm, each freed with freeVector and the array with free
+ */
+Vector **findTopKNormVectorsInTree(RBTree *tree, int k, int *found);
+
+/**
+ * constructs a new arena (0 for the default chunk sizes)
+ * @return the arena, NULL on failure
+ */
+VectorArena *newVectorArena(int chunkVectors, size_t chunkValues);
+
+/**
+ * copies len values into the arena
+ * @return a vector which lives as long as the arena, NULL on failure
+ */
+Vector *arenaAddVector(VectorArena *arena, const double *values, int len);
+
+/**
+ * the free function of a tree of arena vectors, the arena frees them
+ */
+void freeArenaVector(void *pVector);
+
+/**
+ * @return the vector of the arena with the largest norm, NULL if it is empty
+ */
+Vector *findMaxNormVectorInArena(VectorArena *arena);
+
+/**
+ * frees the arena and all of its vectors
+ */
+void freeVectorArena(VectorArena *arena);
+
+/**
+ * finds the k vectors of the tree nearest to q by scanning the whole tree
+ * @param out filled with the vectors by ascending distance
+ * @param found set to the number of vectors found
+ * @return 0 on failure, other on success
+ */
+int kNearestBruteForce(RBTree *tree, const Vector *q, int k, const Vector **out, int *found);
+
+/**
+ * builds a k-d tree over the vectors of a tree, which must all have the same length
+ * @return the index, NULL on failure
+ */
+KdTree *newKdTree(RBTree *tree);
+
+/**
+ * finds the k vectors nearest to q with the index
+ * @param out filled with the vectors by ascending distance
+ * @param found set to the number of vectors found
+ * @return 0 on failure, other on success
+ */
+int kNearest(const KdTree *kd, const Vector *q, int k, const Vector **out, int *found);
+
+/**
+ * frees the index, not the vectors
+ */
+void freeKdTree(KdTree *kd);
+
+/**
+ * copies a string into a key which keeps its length and first bytes in front of it
+ * @return the key, freed with freeStringKey. NULL on failure.
+ */
+char *newStringKey(const char *s);
+
+/**
+ * @return the length of a key made by newStringKey
+ */
+size_t stringKeyLength(const char *s);
+
+/**
+ * CompFunc for keys made by newStringKey, the same order as stringCompare
+ */
+int stringKeyCompare(const void *a, const void *b);
+
+/**
+ * FreeFunc for keys made by newStringKey
+ */
+void freeStringKey(void *s);
+
+/**
+ * joins the strings of the tree in ascending order, each followed by a new line
+ * @return the joined string, to be freed with free. NULL on failure.
+ */
+char *joinRBTree(RBTree *tree);
+
+/**
+ * saves a tree of strings to a binary file
+ * @return 0 on failure, other on success
+ */
+int saveStringRBTree(RBTree *tree, const char *path);
+
+/**
+ * saves a tree of vectors to a binary file
+ * @return 0 on failure, other on success
+ */
+int saveVectorRBTree(RBTree *tree, const char *path);
+
+/**
+ * maps a saved file into memory to answer lookups without loading it
+ * @return the mapped tree, NULL on failure
+ */
+MappedRBTree *mapRBTreeFile(const char *path);
+
+/**
+ * @param key a char* for a string file or a Vector* for a vector file
+ * @return 0 if the item is not in the mapped tree, other if it is
+ */
+int mappedContains(const MappedRBTree *mapped, const void *key);
+
+/**
+ * unmaps a tree mapped by mapRBTreeFile
+ */
+void unmapRBTreeFile(MappedRBTree *mapped);
+
+/**
+ * loads a file saved by saveStringRBTree into a new tree
+ * @return the tree, NULL on failure
+ */
+RBTree *loadStringRBTree(const char *path);
+
+/**
+ * loads a file saved by saveVectorRBTree into a new tree
+ * @return the tree, NULL on failure
+ */
+RBTree *loadVectorRBTree(const char *path);
+
+#endif //STRUCTS_EXT_H
@@ -0,0 +1,131 @@
+/**
+ * @file bench.c
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 12 Dec 2019
+ *
+ * @brief The helpers shared by the benchmarks of RBTree.c and Structs.c
+ *
+ * @section DESCRIPTION
+ * A timer, a seeded random generator and the report format, so the numbers of the benchmarks can be compared
+ * between runs.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bench.h"
+
+#define NANOS_IN_SECOND 1e9
+#define RANDOM_RANGE 4294967296.0
+
+/**
+ * @return the time of a monotonic clock in seconds
+ */
+double getSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / NANOS_IN_SECOND;
+}
+
+/**
+ * the next number of a xorshift generator, the same seed gives the same numbers on every run
+ * @param state the state of the generator, not 0
+ * @return a random number
+ */
+unsigned int nextRandom(unsigned int *state)
+{
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * @param state the state of the generator, not 0
+ * @return a random double in [-1, 1)
+ */
+double nextRandomDouble(unsigned int *state)
+{
+    return 2 * (nextRandom(state) / RANDOM_RANGE) - 1;
+}
+
+/**
+ * the keys 0..count-1 in a random order (Fisher Yates)
+ * @param count the number of keys
+ * @param seed the seed of the order, not 0
+ * @return the keys, to be freed with free. NULL on failure.
+ */
+int *newShuffledKeys(int count, unsigned int seed)
+{
+    int *keys = (int *) malloc((size_t) count * sizeof(int));
+    if (keys == NULL)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        keys[i] = i;
+    }
+    for (int i = count - 1; i > 0; --i)
+    {
+        int j = (int) (nextRandom(&seed) % (unsigned int) (i + 1));
+        int tmp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+    return keys;
+}
+
+/**
+ * CompFunc for int* items
+ * @param a int*
+ * @param b int*
+ * @return lower than 0 if a < b, 0 if they are equal, greater than 0 if a > b
+ */
+int compareInts(const void *a, const void *b)
+{
+    int x = *(const int *) a;
+    int y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * FreeFunc for items the tree does not own
+ * @param data the item
+ */
+void freeNothing(void *data)
+{
+    (void) data;
+}
+
+/**
+ * reads the size of a benchmark from the command line
+ * @param argc the number of arguments
+ * @param argv the arguments
+ * @param defaultCount the size when none is given
+ * @return argv[1] if it is a positive number, defaultCount otherwise
+ */
+int getCount(int argc, char *argv[], int defaultCount)
+{
+    if (argc < 2)
+    {
+        return defaultCount;
+    }
+    int count = atoi(argv[1]);
+    return count > 0 ? count : defaultCount;
+}
+
+/**
+ * prints one line of the report, the time per operation
+ * @param name what was measured
+ * @param ops the number of operations
+ * @param seconds how long they took
+ */
+void printResult(const char *name, size_t ops, double seconds)
+{
+    printf("%-44s %10.1f ns/op %9.3f s\n", name, seconds * NANOS_IN_SECOND / (double) ops, seconds);
+}
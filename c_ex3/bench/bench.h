@@ -0,0 +1,65 @@
+/**
+ * @file bench.h
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 12 Dec 2019
+ *
+ * @brief The helpers shared by the benchmarks of RBTree.c and Structs.c
+ *
+ * @section DESCRIPTION
+ * Every benchmark is its own program (see the Makefile), they share the timer, the random numbers and the
+ * report format from here.
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+
+/**
+ * @return the time of a monotonic clock in seconds
+ */
+double getSeconds(void);
+
+/**
+ * the next number of a xorshift generator, the same seed gives the same numbers on every run
+ * @param state the state of the generator, not 0
+ * @return a random number
+ */
+unsigned int nextRandom(unsigned int *state);
+
+/**
+ * @return a random double in [-1, 1)
+ */
+double nextRandomDouble(unsigned int *state);
+
+/**
+ * the keys 0..count-1 in a random order
+ * @return the keys, to be freed with free. NULL on failure.
+ */
+int *newShuffledKeys(int count, unsigned int seed);
+
+/**
+ * CompFunc for int* items
+ */
+int compareInts(const void *a, const void *b);
+
+/**
+ * FreeFunc for items the tree does not own
+ */
+void freeNothing(void *data);
+
+/**
+ * reads the size of a benchmark from the command line
+ * @return argv[1] if it is a positive number, defaultCount otherwise
+ */
+int getCount(int argc, char *argv[], int defaultCount);
+
+/**
+ * prints one line of the report, the time per operation
+ * @param name what was measured
+ * @param ops the number of operations
+ * @param seconds how long they took
+ */
+void printResult(const char *name, size_t ops, double seconds);
+
+#endif //BENCH_H
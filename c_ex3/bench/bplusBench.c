@@ -0,0 +1,93 @@
+/**
+ * @file bplusBench.c
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 12 Dec 2019
+ *
+ * @brief Benchmark of the B+ tree engine against the red black tree
+ *
+ * @section DESCRIPTION
+ * Fills a red black tree and a B+ tree with the same 2*10^6 int keys (or argv[1]) in a random order, then
+ * times the inserts, random lookups and a full in order scan of both.
+ * Output : the time per operation of each engine
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "RBTree.h"
+#include "RBTreeExt.h"
+#include "bench.h"
+
+#define DEFAULT_COUNT 2000000
+#define KEYS_SEED 10
+#define LOOKUP_SEED 11
+#define SUCCESS 1
+#define FAIL 0
+
+/**
+ * ForEach function which sums the items, so the scan can't be optimized away
+ * @param item int*
+ * @param sum long long*
+ * @return 1
+ */
+int sumItem(const void *item, void *sum)
+{
+    *(long long *) sum += *(const int *) item;
+    return SUCCESS;
+}
+
+/**
+ * times one engine
+ * @param name the name of the engine
+ * @param tree an empty tree
+ * @param keys the keys to insert
+ * @param lookups the keys to look up, in another order
+ * @param count the number of keys
+ * @return a checksum of the results
+ */
+long long runEngine(const char *name, RBTree *tree, int *keys, int *lookups, int count)
+{
+    char label[64];
+    double start = getSeconds();
+    for (int i = 0; i < count; ++i)
+    {
+        addToRBTree(tree, &keys[i]);
+    }
+    snprintf(label, sizeof(label), "%s add", name);
+    printResult(label, (size_t) count, getSeconds() - start);
+
+    long long checksum = 0;
+    start = getSeconds();
+    for (int i = 0; i < count; ++i)
+    {
+        checksum += containsRBTree(tree, &lookups[i]) != FAIL;
+    }
+    snprintf(label, sizeof(label), "%s contains", name);
+    printResult(label, (size_t) count, getSeconds() - start);
+
+    start = getSeconds();
+    forEachRBTree(tree, sumItem, &checksum);
+    snprintf(label, sizeof(label), "%s in order scan", name);
+    printResult(label, (size_t) count, getSeconds() - start);
+    freeRBTree(tree);
+    return checksum;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = getCount(argc, argv, DEFAULT_COUNT);
+    int *keys = newShuffledKeys(count, KEYS_SEED);
+    int *lookups = newShuffledKeys(count, LOOKUP_SEED);
+    RBTree *rbTree = newRBTree(compareInts, freeNothing);
+    RBTree *bplusTree = newBPlusRBTree(compareInts, freeNothing);
+    if (keys == NULL || lookups == NULL || rbTree == NULL || bplusTree == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    printf("engines, %d keys\n", count);
+    long long checksum = runEngine("red black", rbTree, keys, lookups, count);
+    checksum -= runEngine("B+", bplusTree, keys, lookups, count);
+    printf("checksum difference %lld\n", checksum);
+    free(keys);
+    free(lookups);
+    return checksum == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file compareBench.c
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 12 Dec 2019
+ *
+ * @brief Benchmark of vectorCompare1By1
+ *
+ * @section DESCRIPTION
+ * Compares pairs of vectors of dimension 256 with vectorCompare1By1 and with the scalar loop which
+ * Structs.c had before, on random vectors (which differ in the first element) and on vectors which share a long
+ * prefix and differ near the end. 10^7 comparisons per case (or argv[1]).
+ * Output : the time per comparison of each version
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "RBTree.h"
+#include "Structs.h"
+#include "bench.h"
+
+#define DEFAULT_COUNT 10000000
+#define DIMENSION 256
+#define SHARED_PREFIX 240
+#define PAIRS 256
+#define SEED 16
+#define LESS (-1)
+#define EQUAL 0
+#define GREATER 1
+
+/**
+ * the element by element comparison which Structs.c had before. it is not inlined into the benchmark loop,
+ * since vectorCompare1By1 can't be either.
+ * @param a first vector
+ * @param b second vector
+ * @return equal to 0 iff a == b. lower than 0 if a < b. Greater than 0 iff b < a.
+ */
+__attribute__((noinline)) int scalarCompare(const void *a, const void *b)
+{
+    const Vector *v = (const Vector *) a;
+    const Vector *u = (const Vector *) b;
+    int minLen = v->len < u->len ? v->len : u->len;
+    for (int i = 0; i < minLen; ++i)
+    {
+        if (v->vector[i] != u->vector[i])
+        {
+            return v->vector[i] > u->vector[i] ? GREATER : LESS;
+        }
+    }
+    if (v->len == u->len)
+    {
+        return EQUAL;
+    }
+    return minLen == v->len ? LESS : GREATER;
+}
+
+/**
+ * fills the pairs, the vectors of a pair are equal up to prefix and random after it
+ * @param vectors 2 * PAIRS vectors
+ * @param values the elements of all of them
+ * @param prefix the length of the shared prefix
+ */
+void fillPairs(Vector *vectors, double *values, int prefix)
+{
+    unsigned int seed = SEED;
+    for (int p = 0; p < PAIRS; ++p)
+    {
+        double *first = values + 2 * p * DIMENSION;
+        double *second = first + DIMENSION;
+        for (int i = 0; i < DIMENSION; ++i)
+        {
+            first[i] = nextRandomDouble(&seed);
+            second[i] = i < prefix ? first[i] : nextRandomDouble(&seed);
+        }
+        vectors[2 * p].vector = first;
+        vectors[2 * p].len = DIMENSION;
+        vectors[2 * p + 1].vector = second;
+        vectors[2 * p + 1].len = DIMENSION;
+    }
+}
+
+/**
+ * times a comparator on the pairs
+ * @param name what is measured
+ * @param compare the comparator
+ * @param vectors the pairs
+ * @param count the number of comparisons
+ * @return the sum of the results, so the calls can't be optimized away
+ */
+long long timeCompare(const char *name, CompareFunc compare, const Vector *vectors, int count)
+{
+    long long sum = 0;
+    double start = getSeconds();
+    for (int i = 0; i < count; ++i)
+    {
+        int p = i % PAIRS;
+        sum += compare(&vectors[2 * p], &vectors[2 * p + 1]);
+    }
+    printResult(name, (size_t) count, getSeconds() - start);
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = getCount(argc, argv, DEFAULT_COUNT);
+    Vector *vectors = (Vector *) malloc(2 * PAIRS * sizeof(Vector));
+    double *values = (double *) malloc(2 * PAIRS * DIMENSION * sizeof(double));
+    if (vectors == NULL || values == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    printf("vector comparisons, dimension %d\n", DIMENSION);
+    fillPairs(vectors, values, 0);
+    long long scalarSum = timeCompare("random, scalar loop (before)", scalarCompare, vectors, count);
+    long long sum = timeCompare("random, vectorCompare1By1", vectorCompare1By1, vectors, count);
+    fillPairs(vectors, values, SHARED_PREFIX);
+    scalarSum += timeCompare("prefix 240, scalar loop (before)", scalarCompare, vectors, count);
+    sum += timeCompare("prefix 240, vectorCompare1By1", vectorCompare1By1, vectors, count);
+    fillPairs(vectors, values, DIMENSION);
+    scalarSum += timeCompare("equal, scalar loop (before)", scalarCompare, vectors, count);
+    sum += timeCompare("equal, vectorCompare1By1", vectorCompare1By1, vectors, count);
+    printf("%s\n", sum == scalarSum ? "same results" : "DIFFERENT RESULTS");
+    free(vectors);
+    free(values);
+    return sum == scalarSum ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file knnBench.c
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 12 Dec 2019
+ *
+ * @brief Benchmark of the k nearest neighbours search
+ *
+ * @section DESCRIPTION
+ * Fills a tree with 10^5 random vectors (or argv[1]) of dimension 4, 16 and 64, and answers the same random
+ * queries with kNearestBruteForce and with the KD tree of kNearest.
+ * Output : the build time of the KD tree, the time per query of both searches, and the recall of the KD tree
+ * against the brute force results
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "RBTree.h"
+#include "Structs.h"
+#include "StructsExt.h"
+#include "bench.h"
+
+#define DEFAULT_COUNT 100000
+#define QUERIES 200
+#define K 10
+#define SEED 18
+#define DIMENSIONS 3
+#define MAX_DIMENSION 64
+
+/**
+ * runs the queries for one dimension
+ * @param count the number of vectors in the tree
+ * @param dim the dimension of the vectors
+ * @return 0 on failure, other on success
+ */
+int runDimension(int count, int dim)
+{
+    VectorArena *arena = newVectorArena(0, 0);
+    RBTree *tree = newRBTree(vectorCompare1By1, freeArenaVector);
+    Vector *queries = (Vector *) malloc(QUERIES * sizeof(Vector));
+    double *queryValues = (double *) malloc((size_t) QUERIES * dim * sizeof(double));
+    if (arena == NULL || tree == NULL || queries == NULL || queryValues == NULL)
+    {
+        return 0;
+    }
+    unsigned int seed = SEED;
+    double values[MAX_DIMENSION];
+    for (int i = 0; i < count; ++i)
+    {
+        for (int j = 0; j < dim; ++j)
+        {
+            values[j] = nextRandomDouble(&seed);
+        }
+        addToRBTree(tree, arenaAddVector(arena, values, dim));
+    }
+    for (int i = 0; i < QUERIES; ++i)
+    {
+        for (int j = 0; j < dim; ++j)
+        {
+            queryValues[i * dim + j] = nextRandomDouble(&seed);
+        }
+        queries[i].vector = queryValues + i * dim;
+        queries[i].len = dim;
+    }
+    printf("dimension %d\n", dim);
+    double start = getSeconds();
+    KdTree *kd = newKdTree(tree);
+    printResult("  newKdTree (per vector)", (size_t) count, getSeconds() - start);
+
+    const Vector *exact[QUERIES][K];
+    const Vector *near[K];
+    int found = 0;
+    start = getSeconds();
+    for (int i = 0; i < QUERIES; ++i)
+    {
+        kNearestBruteForce(tree, &queries[i], K, exact[i], &found);
+    }
+    printResult("  kNearestBruteForce (per query)", QUERIES, getSeconds() - start);
+
+    int hits = 0;
+    double seconds = 0;
+    for (int i = 0; i < QUERIES; ++i)
+    {
+        start = getSeconds();
+        kNearest(kd, &queries[i], K, near, &found);
+        seconds += getSeconds() - start;
+        for (int a = 0; a < found; ++a)
+        {
+            for (int b = 0; b < K; ++b)
+            {
+                hits += near[a] == exact[i][b];
+            }
+        }
+    }
+    printResult("  kNearest (per query)", QUERIES, seconds);
+    printf("  recall %.4f\n", (double) hits / (QUERIES * K));
+    freeKdTree(kd);
+    freeRBTree(tree);
+    freeVectorArena(arena);
+    free(queries);
+    free(queryValues);
+    return hits == QUERIES * K;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = getCount(argc, argv, DEFAULT_COUNT);
+    int dims[DIMENSIONS] = {4, 16, MAX_DIMENSION};
+    int isOk = 1;
+    printf("k nearest, %d vectors, %d queries, k = %d\n", count, QUERIES, K);
+    for (int i = 0; i < DIMENSIONS; ++i)
+    {
+        isOk &= runDimension(count, dims[i]);
+    }
+    return isOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,199 @@
+/**
+ * @file lockBench.c
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 12 Dec 2019
+ *
+ * @brief Benchmark of the reader writer lock of THREAD_SAFE trees
+ *
+ * @section DESCRIPTION
+ * Reader threads look up random keys of a tree of 10^6 int keys (or argv[1]) while one writer thread keeps
+ * adding and removing other keys. a THREAD_SAFE tree is compared with a plain tree behind one global mutex, for
+ * 1, 2, 4 and 8 readers.
+ * Output : the lookups per second of all the readers together, and the writes per second
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "RBTree.h"
+#include "RBTreeExt.h"
+#include "bench.h"
+
+#define DEFAULT_COUNT 1000000
+#define KEYS_SEED 12
+#define MAX_READERS 8
+#define RUN_MICROS 1000000
+#define MILLION 1e6
+#define THOUSAND 1e3
+#define FAIL 0
+
+/**
+ * what the threads of a run share
+ */
+typedef struct Shared
+{
+    RBTree *tree;
+    pthread_mutex_t *mutex;
+    int *keys;
+    int count;
+    int *extra;
+    int extraCount;
+    int stop;
+} Shared;
+
+/**
+ * a thread of a run and what it counted
+ */
+typedef struct Worker
+{
+    Shared *shared;
+    unsigned int seed;
+    long long ops;
+    long long found;
+} Worker;
+
+/**
+ * looks up random keys until the run stops
+ * @param arg the worker
+ * @return NULL
+ */
+void *readerMain(void *arg)
+{
+    Worker *worker = (Worker *) arg;
+    Shared *shared = worker->shared;
+    while (!__atomic_load_n(&shared->stop, __ATOMIC_RELAXED))
+    {
+        int *key = &shared->keys[nextRandom(&worker->seed) % (unsigned int) shared->count];
+        if (shared->mutex != NULL)
+        {
+            pthread_mutex_lock(shared->mutex);
+        }
+        worker->found += containsRBTree(shared->tree, key) != FAIL;
+        if (shared->mutex != NULL)
+        {
+            pthread_mutex_unlock(shared->mutex);
+        }
+        ++worker->ops;
+    }
+    return NULL;
+}
+
+/**
+ * adds and removes the extra keys until the run stops, so the size of the tree stays the same
+ * @param arg the worker
+ * @return NULL
+ */
+void *writerMain(void *arg)
+{
+    Worker *worker = (Worker *) arg;
+    Shared *shared = worker->shared;
+    for (int i = 0; !__atomic_load_n(&shared->stop, __ATOMIC_RELAXED); i = (i + 1) % shared->extraCount)
+    {
+        if (shared->mutex != NULL)
+        {
+            pthread_mutex_lock(shared->mutex);
+        }
+        addToRBTree(shared->tree, &shared->extra[i]);
+        deleteFromRBTree(shared->tree, &shared->extra[i]);
+        if (shared->mutex != NULL)
+        {
+            pthread_mutex_unlock(shared->mutex);
+        }
+        worker->ops += 2;
+    }
+    return NULL;
+}
+
+/**
+ * runs the readers and the writer for a while
+ * @param name the name of the mode
+ * @param shared the tree and the keys
+ * @param readers the number of reader threads
+ * @return the number of keys the readers found
+ */
+long long runReaders(const char *name, Shared *shared, int readers)
+{
+    pthread_t threads[MAX_READERS + 1];
+    Worker workers[MAX_READERS + 1];
+    shared->stop = 0;
+    for (int i = 0; i <= readers; ++i)
+    {
+        workers[i].shared = shared;
+        workers[i].seed = (unsigned int) i + 1;
+        workers[i].ops = 0;
+        workers[i].found = 0;
+        pthread_create(&threads[i], NULL, i == readers ? writerMain : readerMain, &workers[i]);
+    }
+    double start = getSeconds();
+    usleep(RUN_MICROS);
+    __atomic_store_n(&shared->stop, 1, __ATOMIC_RELAXED);
+    long long lookups = 0;
+    long long found = 0;
+    for (int i = 0; i <= readers; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        if (i < readers)
+        {
+            lookups += workers[i].ops;
+            found += workers[i].found;
+        }
+    }
+    double seconds = getSeconds() - start;
+    printf("%-20s %d readers %10.2f M lookups/s %10.1f k writes/s\n", name, readers,
+           (double) lookups / seconds / MILLION, (double) workers[readers].ops / seconds / THOUSAND);
+    return found;
+}
+
+/**
+ * fills a tree and runs it with 1, 2, 4 and 8 readers
+ * @param name the name of the mode
+ * @param shared the keys, the tree is set here
+ * @param tree an empty tree
+ * @param mutex the global mutex, NULL for a THREAD_SAFE tree
+ * @return the number of keys the readers found
+ */
+long long runMode(const char *name, Shared *shared, RBTree *tree, pthread_mutex_t *mutex)
+{
+    shared->tree = tree;
+    shared->mutex = mutex;
+    for (int i = 0; i < shared->count; ++i)
+    {
+        addToRBTree(tree, &shared->keys[i]);
+    }
+    long long found = 0;
+    for (int readers = 1; readers <= MAX_READERS; readers *= 2)
+    {
+        found += runReaders(name, shared, readers);
+    }
+    freeRBTree(tree);
+    return found;
+}
+
+int main(int argc, char *argv[])
+{
+    Shared shared;
+    shared.count = getCount(argc, argv, DEFAULT_COUNT);
+    shared.extraCount = shared.count;
+    shared.keys = newShuffledKeys(shared.count, KEYS_SEED);
+    shared.extra = (int *) malloc((size_t) shared.extraCount * sizeof(int));
+    RBTree *plainTree = newRBTree(compareInts, freeNothing);
+    RBTree *safeTree = newRBTreeWithPool(compareInts, freeNothing, 0, THREAD_SAFE);
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    if (shared.keys == NULL || shared.extra == NULL || plainTree == NULL || safeTree == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < shared.extraCount; ++i)
+    {
+        shared.extra[i] = shared.count + i;
+    }
+    printf("locks, %d keys, %ld cpus online\n", shared.count, sysconf(_SC_NPROCESSORS_ONLN));
+    long long found = runMode("global mutex", &shared, plainTree, &mutex);
+    found += runMode("THREAD_SAFE rwlock", &shared, safeTree, NULL);
+    printf("checksum %lld\n", found);
+    free(shared.keys);
+    free(shared.extra);
+    return EXIT_SUCCESS;
+}
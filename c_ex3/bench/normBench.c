@@ -0,0 +1,138 @@
+/**
+ * @file normBench.c
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 12 Dec 2019
+ *
+ * @brief Benchmark of findMaxNormVectorInTree
+ *
+ * @section DESCRIPTION
+ * Fills a tree with 10^6 random vectors of dimension 256 (or argv[1] vectors) and finds the one with the largest
+ * norm: with the scalar copyIfNormIsLarger which Structs.c had before (two norms and a copy per new maximum),
+ * with findMaxNormVectorInTree (one vector kernel norm per vector, one copy at the end), on several threads, and
+ * by scanning the arena which holds the vectors.
+ * Output : the time per vector of each version
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "RBTree.h"
+#include "Structs.h"
+#include "StructsExt.h"
+#include "bench.h"
+
+#define DEFAULT_COUNT 1000000
+#define DIMENSION 256
+#define SEED 14
+#define THREADS 4
+#define SUCCESS 1
+#define FAIL 0
+
+/**
+ * the scalar norm which Structs.c had before
+ * @param v the vector
+ * @return the squared norm
+ */
+double scalarNorm(const Vector *v)
+{
+    double norm = 0;
+    for (int i = 0; i < v->len; ++i)
+    {
+        norm += v->vector[i] * v->vector[i];
+    }
+    return norm;
+}
+
+/**
+ * the copyIfNormIsLarger which Structs.c had before, it computes both norms on every call
+ * @param pVector pointer to Vector
+ * @param pMaxVector pointer to Vector
+ * @return 1 on success, 0 on failure
+ */
+int scalarCopyIfNormIsLarger(const void *pVector, void *pMaxVector)
+{
+    const Vector *toCopy = (const Vector *) pVector;
+    Vector *maxVec = (Vector *) pMaxVector;
+    if (maxVec->vector == NULL || scalarNorm(maxVec) < scalarNorm(toCopy))
+    {
+        free(maxVec->vector);
+        maxVec->vector = (double *) malloc(sizeof(double) * toCopy->len);
+        if (maxVec->vector == NULL)
+        {
+            return FAIL;
+        }
+        for (int i = 0; i < toCopy->len; ++i)
+        {
+            maxVec->vector[i] = toCopy->vector[i];
+        }
+        maxVec->len = toCopy->len;
+    }
+    return SUCCESS;
+}
+
+/**
+ * prints a result and checks that it found the same vector as the baseline
+ * @param name what was measured
+ * @param count the number of vectors
+ * @param seconds how long it took
+ * @param found the vector it found
+ * @param expected the vector the baseline found
+ * @return 1 if the norms match, 0 otherwise
+ */
+int report(const char *name, int count, double seconds, const Vector *found, const Vector *expected)
+{
+    printResult(name, (size_t) count, seconds);
+    return found != NULL && scalarNorm(found) == scalarNorm(expected);
+}
+
+int main(int argc, char *argv[])
+{
+    int count = getCount(argc, argv, DEFAULT_COUNT);
+    VectorArena *arena = newVectorArena(0, 0);
+    RBTree *tree = newRBTree(vectorCompare1By1, freeArenaVector);
+    double *values = (double *) malloc(DIMENSION * sizeof(double));
+    if (arena == NULL || tree == NULL || values == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    unsigned int seed = SEED;
+    for (int i = 0; i < count; ++i)
+    {
+        for (int j = 0; j < DIMENSION; ++j)
+        {
+            values[j] = nextRandomDouble(&seed);
+        }
+        Vector *v = arenaAddVector(arena, values, DIMENSION);
+        if (v == NULL || !addToRBTree(tree, v))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    printf("max norm, %d vectors of dimension %d\n", count, DIMENSION);
+
+    Vector baseline;
+    baseline.vector = NULL;
+    baseline.len = 0;
+    double start = getSeconds();
+    forEachRBTree(tree, scalarCopyIfNormIsLarger, &baseline);
+    printResult("scalar copyIfNormIsLarger (before)", (size_t) count, getSeconds() - start);
+
+    int isOk = SUCCESS;
+    start = getSeconds();
+    Vector *found = findMaxNormVectorInTree(tree);
+    isOk &= report("findMaxNormVectorInTree", count, getSeconds() - start, found, &baseline);
+    freeVector(found);
+    start = getSeconds();
+    found = findMaxNormVectorInTreeParallel(tree, THREADS);
+    isOk &= report("findMaxNormVectorInTreeParallel, 4 threads", count, getSeconds() - start, found, &baseline);
+    freeVector(found);
+    start = getSeconds();
+    const Vector *inArena = findMaxNormVectorInArena(arena);
+    isOk &= report("findMaxNormVectorInArena", count, getSeconds() - start, inArena, &baseline);
+
+    free(baseline.vector);
+    free(values);
+    freeRBTree(tree);
+    freeVectorArena(arena);
+    printf("%s\n", isOk ? "same vector" : "DIFFERENT VECTOR");
+    return isOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
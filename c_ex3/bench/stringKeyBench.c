@@ -0,0 +1,179 @@
+/**
+ * @file stringKeyBench.c
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 12 Dec 2019
+ *
+ * @brief Benchmark of the string keys and of joinRBTree
+ *
+ * @section DESCRIPTION
+ * Builds 10^6 words (or argv[1]) out of common syllables, so many of them share prefixes like the words of a
+ * dictionary do, and compares a tree of plain strings (stringCompare) with a tree of string keys
+ * (stringKeyCompare). then compares joining a tree with concatenate, which walks the joined text on every word,
+ * and with joinRBTree.
+ * Output : the time per word of each version
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "RBTree.h"
+#include "Structs.h"
+#include "StructsExt.h"
+#include "bench.h"
+
+#define DEFAULT_COUNT 1000000
+#define JOIN_WORDS 100000
+#define SEED 19
+#define SYLLABLES 32
+#define MIN_SYLLABLES 2
+#define MORE_SYLLABLES 4
+#define MAX_WORD 64
+
+/**
+ * a new random word of 2 to 5 syllables
+ * @param seed the state of the random generator
+ * @return the word, to be freed with free. NULL on failure.
+ */
+char *newWord(unsigned int *seed)
+{
+    static const char *syllables[SYLLABLES] = {"a", "al", "an", "ar", "be", "ca", "co", "con", "de", "di", "en",
+                                               "er", "es", "in", "is", "la", "le", "ma", "me", "ne", "o", "on",
+                                               "pa", "pro", "ra", "re", "ri", "sa", "se", "ta", "ti", "to"};
+    char word[MAX_WORD] = "";
+    int count = MIN_SYLLABLES + (int) (nextRandom(seed) % MORE_SYLLABLES);
+    for (int i = 0; i < count; ++i)
+    {
+        strcat(word, syllables[nextRandom(seed) % SYLLABLES]);
+    }
+    char *copy = (char *) malloc(strlen(word) + 1);
+    if (copy != NULL)
+    {
+        strcpy(copy, word);
+    }
+    return copy;
+}
+
+/**
+ * times adding the words to a tree and looking all of them up
+ * @param name the name of the tree
+ * @param tree an empty tree
+ * @param words the words
+ * @param count the number of words
+ * @param isKey if not 0 the words are copied into string keys first
+ * @return the number of words found
+ */
+int timeTree(const char *name, RBTree *tree, char **words, int count, int isKey)
+{
+    char label[64];
+    char **items = (char **) malloc((size_t) count * sizeof(char *));
+    char **lookups = (char **) malloc((size_t) count * sizeof(char *));
+    if (items == NULL || lookups == NULL)
+    {
+        free(items);
+        return 0;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        items[i] = isKey ? newStringKey(words[i]) : words[i];
+        lookups[i] = isKey ? newStringKey(words[i]) : words[i];
+    }
+    double start = getSeconds();
+    for (int i = 0; i < count; ++i)
+    {
+        if (!addToRBTree(tree, items[i]) && isKey)
+        {
+            freeStringKey(items[i]);
+        }
+    }
+    snprintf(label, sizeof(label), "%s add", name);
+    printResult(label, (size_t) count, getSeconds() - start);
+    int found = 0;
+    start = getSeconds();
+    for (int i = 0; i < count; ++i)
+    {
+        found += containsRBTree(tree, lookups[i]) != 0;
+    }
+    snprintf(label, sizeof(label), "%s contains", name);
+    printResult(label, (size_t) count, getSeconds() - start);
+    for (int i = 0; isKey && i < count; ++i)
+    {
+        freeStringKey(lookups[i]);
+    }
+    free(items);
+    free(lookups);
+    return found;
+}
+
+/**
+ * times joining a tree with concatenate and with joinRBTree
+ * @param tree a tree of plain strings
+ * @param totalLen the length of the joined text
+ * @return 1 if both gave the same text, 0 otherwise
+ */
+int timeJoin(RBTree *tree, size_t totalLen)
+{
+    char label[64];
+    char *concatenated = (char *) malloc(totalLen + 1);
+    if (concatenated == NULL)
+    {
+        return 0;
+    }
+    concatenated[0] = '\0';
+    double start = getSeconds();
+    forEachRBTree(tree, concatenate, concatenated);
+    snprintf(label, sizeof(label), "concatenate, %zu words (before)", tree->size);
+    printResult(label, tree->size, getSeconds() - start);
+    start = getSeconds();
+    char *joined = joinRBTree(tree);
+    snprintf(label, sizeof(label), "joinRBTree, %zu words", tree->size);
+    printResult(label, tree->size, getSeconds() - start);
+    int isSame = joined != NULL && strcmp(joined, concatenated) == 0;
+    free(joined);
+    free(concatenated);
+    return isSame;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = getCount(argc, argv, DEFAULT_COUNT);
+    char **words = (char **) malloc((size_t) count * sizeof(char *));
+    RBTree *plainTree = newRBTree(stringCompare, freeNothing);
+    RBTree *keyTree = newRBTree(stringKeyCompare, freeStringKey);
+    RBTree *joinTree = newRBTree(stringCompare, freeNothing);
+    if (words == NULL || plainTree == NULL || keyTree == NULL || joinTree == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    unsigned int seed = SEED;
+    size_t joinLen = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        words[i] = newWord(&seed);
+        if (words[i] == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+        if (i < JOIN_WORDS && addToRBTree(joinTree, words[i]))
+        {
+            joinLen += strlen(words[i]) + 1;
+        }
+    }
+    printf("strings, %d words\n", count);
+    int found = timeTree("stringCompare", plainTree, words, count, 0);
+    found -= timeTree("stringKeyCompare", keyTree, words, count, 1);
+    int isOk = found == 0 && timeJoin(joinTree, joinLen);
+    double start = getSeconds();
+    char *joined = joinRBTree(plainTree);
+    printResult("joinRBTree, whole tree", plainTree->size, getSeconds() - start);
+    printf("%zu distinct words, %s\n", plainTree->size, isOk ? "same results" : "DIFFERENT RESULTS");
+    free(joined);
+    freeRBTree(plainTree);
+    freeRBTree(keyTree);
+    freeRBTree(joinTree);
+    for (int i = 0; i < count; ++i)
+    {
+        free(words[i]);
+    }
+    free(words);
+    return isOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
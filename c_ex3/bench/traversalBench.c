@@ -0,0 +1,118 @@
+/**
+ * @file traversalBench.c
+ * @author  Brahan Wassan <brahan>
+ * @version 1.0
+ * @date 12 Dec 2019
+ *
+ * @brief Benchmark of the iterative lookup and in order walk of RBTree.c
+ *
+ * @section DESCRIPTION
+ * Builds a tree of 10^7 int keys (or argv[1]) and compares containsRBTree and forEachRBTree with recursive
+ * versions over the same nodes, which is how RBTree.c walked the tree before.
+ * Output : the time per operation of each version
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "RBTree.h"
+#include "bench.h"
+
+#define DEFAULT_COUNT 10000000
+#define SEED 3
+#define FAIL 0
+#define SUCCESS 1
+
+/**
+ * the recursive lookup which the iterative one replaced
+ * @param node the subtree root
+ * @param data the item
+ * @return 1 if the item is in the subtree, 0 otherwise
+ */
+int recursiveContains(Node *node, const void *data)
+{
+    if (node == NULL)
+    {
+        return FAIL;
+    }
+    int comp = compareInts(node->data, data);
+    if (comp == 0)
+    {
+        return SUCCESS;
+    }
+    return recursiveContains(comp > 0 ? node->left : node->right, data);
+}
+
+/**
+ * the recursive in order walk which the bounded explicit stack walk (startWalk / walkNext) replaced
+ * @param node the subtree root
+ * @param func the function to activate on all items
+ * @param args more optional arguments to the function
+ * @return 0 if one of the activations failed, other otherwise
+ */
+int recursiveInOrder(Node *node, forEachFunc func, void *args)
+{
+    if (node == NULL)
+    {
+        return SUCCESS;
+    }
+    return recursiveInOrder(node->left, func, args) && func(node->data, args) &&
+           recursiveInOrder(node->right, func, args);
+}
+
+/**
+ * ForEach function which sums the items, so the walk can't be optimized away
+ * @param item int*
+ * @param sum long long*
+ * @return 1
+ */
+int sumItem(const void *item, void *sum)
+{
+    *(long long *) sum += *(const int *) item;
+    return SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = getCount(argc, argv, DEFAULT_COUNT);
+    int *keys = newShuffledKeys(count, SEED);
+    RBTree *tree = newRBTree(compareInts, freeNothing);
+    if (keys == NULL || tree == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    printf("traversal, %d keys\n", count);
+    double start = getSeconds();
+    for (int i = 0; i < count; ++i)
+    {
+        addToRBTree(tree, &keys[i]);
+    }
+    printResult("addToRBTree", (size_t) count, getSeconds() - start);
+
+    int found = 0;
+    start = getSeconds();
+    for (int i = 0; i < count; ++i)
+    {
+        found += containsRBTree(tree, &keys[i]) != FAIL;
+    }
+    printResult("containsRBTree (iterative)", (size_t) count, getSeconds() - start);
+    start = getSeconds();
+    for (int i = 0; i < count; ++i)
+    {
+        found += recursiveContains(tree->root, &keys[i]);
+    }
+    printResult("recursive contains", (size_t) count, getSeconds() - start);
+
+    long long sum = 0;
+    start = getSeconds();
+    forEachRBTree(tree, sumItem, &sum);
+    printResult("forEachRBTree (explicit stack)", (size_t) count, getSeconds() - start);
+    start = getSeconds();
+    recursiveInOrder(tree->root, sumItem, &sum);
+    printResult("recursive in order", (size_t) count, getSeconds() - start);
+
+    start = getSeconds();
+    freeRBTree(tree);
+    printResult("freeRBTree", (size_t) count, getSeconds() - start);
+    printf("checksum %d %lld\n", found, sum);
+    free(keys);
+    return EXIT_SUCCESS;
+}